@@ -28,20 +28,20 @@
  */
 
 #include <cerrno>
+#include <cstdlib>
+#include <cstring>
 
-#include <iostream>
-#include <fstream>
-#include <list>
-#include <boost/algorithm/string.hpp>
-#include <XmlRpcValue.h>
 #include "cpuinfo.hpp"
+#include "log.hpp"
+#include "parse.hpp"
 
 namespace sysmon {
 
-CpuInfo::CpuInfo()
-{
-    fill_whitelist();
-}
+CpuInfo::CpuInfo(FileSet &files, const std::set<std::string> &whitelist) :
+    m_whitelist(whitelist),
+    m_files(&files),
+    m_source(files.add("/proc/cpuinfo"))
+{}
 
 unsigned int CpuInfo::nproc()
 {
@@ -49,91 +49,53 @@ unsigned int CpuInfo::nproc()
     return m_values.size();
 }
 
-void CpuInfo::ros_update(unsigned int proc, diagnostic_updater::DiagnosticStatusWrapper &dsw)
+const CpuInfo::cpuinfo & CpuInfo::values(unsigned int proc) const
 {
-    if (proc > m_values.size()) {
-        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Unknown processor id");
-        return;
-    }
-
-    if (update()) {
-        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Update failed");
-        return;
-    }
-
-    dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
-    for (cpuinfoIter it = m_values[proc].begin(); it != m_values[proc].end(); ++it) {
-        if (m_whitelist.size()) {
-            if (std::find(m_whitelist.begin(), m_whitelist.end(), (*it).first) != m_whitelist.end())
-                dsw.add((*it).first, (*it).second);
-        } else {
-            dsw.add((*it).first, (*it).second);
-        }
-    }
+    return m_values[proc];
 }
 
 int CpuInfo::update()
 {
-    std::ifstream fp("/proc/cpuinfo");
-
-    if (!fp.is_open()) {
-        ROS_ERROR("%s:  Failed to open /proc/cpuinfo", __func__);
+    const char *data;
+    size_t len;
+    if (m_files->get(m_source, data, len)) {
+        log_error("%s:  Failed to read /proc/cpuinfo", __func__);
         return EIO;
     }
 
-    std::string line;
+    /* model name\t: Intel(R) Core(TM) i7-2600 CPU @ 3.40GHz */
     unsigned int processor = 0;
-    while (fp.good()) {
-        getline(fp, line);
-
-        std::list<std::string> res;
-        boost::algorithm::split(res, line, boost::is_any_of(":"));
-
-        if (res.size() < 2)
-            continue;
-
-        std::string key = res.front();
-        boost::trim(key);
-
-        res.pop_front();
-        std::string value = boost::algorithm::join(res, " ");
-        boost::trim(value);
-
-        if (key == "processor")
-            processor = boost::lexical_cast<unsigned int>(value);
-
-        if (processor >= m_values.size())
-            m_values.push_back(std::map<std::string, std::string>());
+    const char *end = data + len;
+    for (const char *p = data; p < end; ++p) {
+        const char *eol = line_end(p, end);
+        const char *sep = static_cast<const char *>(memchr(p, ':', eol - p));
+
+        if (sep) {
+            const char *key = p;
+            const char *key_end = sep;
+            const char *value = sep + 1;
+            const char *value_end = eol;
+
+            trim(key, key_end);
+            trim(value, value_end);
+
+            m_key.assign(key, key_end - key);
+            if (m_key == "processor")
+                processor = strtoul(value, NULL, 10);
+
+            while (processor >= m_values.size())
+                m_values.push_back(cpuinfo());
+
+            cpuinfo::iterator it = m_values[processor].find(m_key);
+            if (it == m_values[processor].end())
+                it = m_values[processor].insert(std::make_pair(m_key, std::string())).first;
+            (*it).second.assign(value, value_end - value);
+        }
 
-        if (m_values[processor].find(key) != m_values[processor].end())
-            m_values[processor][key] = value;
-        else
-            m_values[processor].insert(std::pair<std::string, std::string>(key, value));
+        p = eol;
     }
 
-    fp.close();
-
     return 0;
 }
 
-void CpuInfo::fill_whitelist()
-{
-    if (!ros::param::has("~cpuinfo/whitelist"))
-        return;
-
-    XmlRpc::XmlRpcValue whitelist;
-    ros::param::get("~cpuinfo/whitelist", whitelist);
-    if (whitelist.getType() != XmlRpc::XmlRpcValue::TypeArray) {
-        ROS_ERROR("%s:  Invalid value (not TypeArray) for ~cpuinfo/whitelist", __func__);
-        return;
-    }
-
-    for (int i = 0; i < whitelist.size(); ++i) {
-        if (whitelist[i].getType() != XmlRpc::XmlRpcValue::TypeString)
-            continue;
-
-        m_whitelist.insert(static_cast<std::string>(whitelist[i]));
-    }
-}
-
 } // namespace sysmon
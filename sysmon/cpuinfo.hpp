@@ -29,8 +29,13 @@
 
 #pragma once
 
+#include <map>
+#include <set>
 #include <string>
-#include <diagnostic_updater/diagnostic_updater.h>
+#include <vector>
+
+#include "diagnostics.hpp"
+#include "fileset.hpp"
 
 namespace sysmon {
 
@@ -38,11 +43,6 @@ class CpuInfo {
     /*
      * Parser for /proc/cpuinfo.  Reads the key value pairs from the file
      * and publishes them via ROS diagnostics.
-     *
-     * ROS Parameters:
-     *
-     * ~/cpuinfo/whitelist: List of keys from /proc/cpuinfo that should be
-     *                      published.  This is a list of XmlRpcValue::TypeString.
      */
     public:
         typedef std::map<std::string, std::string> cpuinfo;
@@ -50,38 +50,45 @@ class CpuInfo {
 
         /*
          * Constructor
+         *
+         * @param files     - Set /proc/cpuinfo is registered with and read from.
+         * @param whitelist - Keys that should be published, everything if
+         *                    empty (~cpuinfo/whitelist in sysmon).
          */
-        CpuInfo();
+        CpuInfo(FileSet &files, const std::set<std::string> &whitelist = std::set<std::string>());
 
         /*
-         * Get the number of available processors.
+         * Read the latest value from /proc/cpuinfo.
          *
-         * @return  - number of processors on the system.
+         * @return  - 0 on success, appropriate errno otherwise.
          */
-        unsigned int nproc();
+        int update();
 
         /*
-         * Update the ROS diagnostics.
+         * Get the number of available processors.
+         *
+         * @return  - number of processors on the system.
          */
-        void ros_update(unsigned int proc, diagnostic_updater::DiagnosticStatusWrapper &dsw);
+        unsigned int nproc();
 
-    private:
         /*
-         * Read the latest value from /proc/cpuinfo.
-         *
-         * @return  - 0 on success, appropriate errno otherwise.
+         * Key value pairs of a processor as of the last update().
          */
-        int update();
+        const cpuinfo & values(unsigned int proc) const;
 
         /*
-         * Query the parameter server for the whitelist of keys that should
-         * be published.
+         * Update the ROS diagnostics (sysmon node only).
          */
-        void fill_whitelist();
+        void ros_update(unsigned int proc, diagnostic_updater::DiagnosticStatusWrapper &dsw);
 
+    private:
         std::vector<cpuinfo> m_values;
+        std::string          m_key;
 
         std::set<std::string> m_whitelist;
+
+        FileSet *           m_files;
+        int                 m_source;
 };
 
 } // namespace sysmon
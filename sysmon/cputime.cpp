@@ -28,17 +28,35 @@
  */
 
 #include <cerrno>
+#include <cstdlib>
+#include <cstring>
 
-#include <iostream>
-#include <fstream>
-#include <list>
-#include <boost/algorithm/string.hpp>
+#include <sstream>
 
+#include "clock.hpp"
 #include "cputime.hpp"
+#include "log.hpp"
+#include "parse.hpp"
 
 namespace sysmon {
 
-CpuTime::CpuTime()
+CpuTime::CpuTime(FileSet &files) :
+    m_ctxt(0),
+    m_processes(0),
+    m_intr(0),
+    m_procs_running(0),
+    m_procs_blocked(0),
+    m_run_queue(0),
+    m_last_ctxt(0),
+    m_last_processes(0),
+    m_last_intr(0),
+    m_last(0),
+    m_last_cycle(-1),
+    m_ctxt_rate(0),
+    m_fork_rate(0),
+    m_intr_rate(0),
+    m_files(&files),
+    m_source(files.add("/proc/stat"))
 {}
 
 unsigned int CpuTime::nproc()
@@ -47,94 +65,147 @@ unsigned int CpuTime::nproc()
     return m_values.size();
 }
 
-void CpuTime::ros_update(int proc, diagnostic_updater::DiagnosticStatusWrapper &dsw)
+void CpuTime::record(Sink &sink) const
 {
-    if (proc > m_values.size() && proc < -1) {
-        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Unknown processor id");
-        return;
-    }
-
-    if (update()) {
-        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Update failed");
-        return;
-    }
-
-    dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
-
-    if (proc == -1) {
-        for (cputimeIter it = m_totals.begin(); it != m_totals.end(); ++it)
-            dsw.add((*it).first, (*it).second);
-    } else {
-        for (cputimeIter it = m_values[proc].begin(); it != m_values[proc].end(); ++it)
-            dsw.add((*it).first, (*it).second);
+    static const std::string total("CPU Time - Total");
+    static const std::string ctxt("context switches/s");
+    static const std::string forks("forks/s");
+    static const std::string intr("interrupts/s");
+    static const std::string running("procs_running");
+    static const std::string blocked("procs_blocked");
+    static const std::string run_queue("run queue per cpu");
+
+    for (cputimeIter it = m_totals.begin(); it != m_totals.end(); ++it)
+        sink.add(total, (*it).first, (*it).second);
+
+    sink.add(total, ctxt, m_ctxt_rate);
+    sink.add(total, forks, m_fork_rate);
+    sink.add(total, intr, m_intr_rate);
+    sink.add(total, running, m_procs_running);
+    sink.add(total, blocked, m_procs_blocked);
+    if (m_values.size())
+        sink.add(total, run_queue, m_run_queue);
+
+    for (unsigned int i = 0; i < m_values.size(); ++i) {
+        for (cputimeIter it = m_values[i].begin(); it != m_values[i].end(); ++it)
+            sink.add(m_tasks[i], (*it).first, (*it).second);
     }
 }
 
 int CpuTime::update()
 {
-    std::ifstream fp("/proc/stat");
-
-    if (!fp.is_open()) {
-        ROS_ERROR("%s:  Failed to open /proc/cputime", __func__);
+    const char *data;
+    size_t len;
+    if (m_files->get(m_source, data, len)) {
+        log_error("%s:  Failed to read /proc/stat", __func__);
         return EIO;
     }
 
-    std::string line;
-    unsigned int processor = -1;
-    while (fp.good()) {
-        getline(fp, line);
+    const char *end = data + len;
+    for (const char *p = data; p < end; ++p) {
+        const char *eol = line_end(p, end);
 
-        if (!boost::algorithm::starts_with(line, "cpu"))
-            break;
+        if (eol - p < 3 || strncmp(p, "cpu", 3))
+            parse_activity(p, eol);
+        else
+            parse_cpu(p, eol);
 
-        std::vector<std::string> res;
-        boost::algorithm::split(res, line, boost::is_any_of(" \t"), boost::token_compress_on);
+        p = eol;
+    }
 
-        if (res.size() < 11)
-            continue;
+    if (m_values.size())
+        m_run_queue = (double)m_procs_running / m_values.size();
 
-        std::string key = res.front();
-        boost::trim(key);
+    update_rates();
 
-        if (key.length() > 3) {
-            std::string str_processor = key.substr(3, key.length());
-            processor = boost::lexical_cast<unsigned int>(str_processor);
+    return 0;
+}
+
+void CpuTime::parse_cpu(const char *line, const char *eol)
+{
+    static const char * names[] = { "user",     "nice", "system",
+                                    "idle",     "iowait",   "irq",  "softirq",
+                                    "steal",    "guest",    "guest_nice" };
+    static const unsigned int ncolumns = sizeof(names) / sizeof(names[0]);
+
+    unsigned long long values[ncolumns];
+    unsigned long long total = 0;
+    const char *p = line + 3;
+    char *next;
+
+    cputime *dest = &m_totals;
+    if (*p != ' ' && *p != '\t') {
+        unsigned int processor = strtoul(p, &next, 10);
+        if (next == p)
+            return;
+        p = next;
+
+        while (processor >= m_values.size()) {
+            std::ostringstream s;
+            s << "Cpu Time - Processor " << m_values.size();
+            m_tasks.push_back(s.str());
+            m_values.push_back(cputime());
         }
+        dest = &m_values[processor];
+    }
 
-        static const char * names[] = { NULL,   "user",     "nice", "system",
-                                        "idle", "iowait",   "irq",  "softirq",
-                                        "steal","guest",    "guest_nice" };
+    for (unsigned int i = 0; i < ncolumns; ++i) {
+        values[i] = strtoull(p, &next, 10);
+        if (next == p || next > eol)
+            return;
+        p = next;
+        total += values[i];
+    }
 
-        cputime *dest = &m_totals;
-        if (processor != -1) {
-            if (processor >= m_values.size())
-                m_values.push_back(std::map<std::string, std::string>());
-            dest = &m_values[processor];
-        }
+    for (unsigned int i = 0; i < ncolumns; ++i)
+        assign_format((*dest)[names[i]], "%llu", values[i]);
+    assign_format((*dest)["total"], "%llu", total);
+}
 
-        unsigned int total = 0;
+void CpuTime::parse_activity(const char *line, const char *eol)
+{
+    static const struct {
+        const char *               name;
+        size_t                     len;
+        unsigned long long CpuTime::*dest;
+    } keys[] = {
+        { "ctxt ",          5,  &CpuTime::m_ctxt },
+        { "processes ",     10, &CpuTime::m_processes },
+        { "intr ",          5,  &CpuTime::m_intr },
+        { "procs_running ", 14, &CpuTime::m_procs_running },
+        { "procs_blocked ", 14, &CpuTime::m_procs_blocked },
+    };
+
+    for (unsigned int i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+        if ((size_t)(eol - line) < keys[i].len || strncmp(line, keys[i].name, keys[i].len))
+            continue;
 
-        for (unsigned int i = 1; i < 11; ++i)
-        {
-            total += boost::lexical_cast<unsigned int>(res[i]);
+        /* Only the leading total is wanted from the (very long) intr line */
+        this->*keys[i].dest = strtoull(line + keys[i].len, NULL, 10);
+        return;
+    }
+}
 
-            if (dest->find(key) != dest->end())
-                (*dest)[names[i]] = res[i];
-            else
-                dest->insert(std::pair<std::string, std::string>(names[i], res[i]));
-        }
+void CpuTime::update_rates()
+{
+    /* Every task updates, only the first update of a cycle sees new counters */
+    if (m_files->cycle() == m_last_cycle)
+        return;
+    m_last_cycle = m_files->cycle();
 
-        std::string str_total = boost::lexical_cast<std::string>(total);
+    double now = monotonic_seconds();
+    double dt = now - m_last;
 
-        if (dest->find("total") != dest->end())
-            (*dest)["total"] = str_total;
-        else
-            dest->insert(std::pair<std::string, std::string>("total", str_total));
+    if (m_last > 0 && dt > 0) {
+        m_ctxt_rate = m_ctxt >= m_last_ctxt ? (m_ctxt - m_last_ctxt) / dt : 0;
+        m_fork_rate = m_processes >= m_last_processes ? (m_processes - m_last_processes) / dt : 0;
+        m_intr_rate = m_intr >= m_last_intr ? (m_intr - m_last_intr) / dt : 0;
     }
 
-    fp.close();
-
-    return 0;
+    m_last_ctxt = m_ctxt;
+    m_last_processes = m_processes;
+    m_last_intr = m_intr;
+    m_last = now;
 }
 
 } // namespace sysmon
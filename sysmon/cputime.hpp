@@ -29,15 +29,23 @@
 
 #pragma once
 
+#include <map>
 #include <string>
-#include <diagnostic_updater/diagnostic_updater.h>
+#include <vector>
+
+#include "diagnostics.hpp"
+#include "fileset.hpp"
+#include "sink.hpp"
 
 namespace sysmon {
 
 class CpuTime {
     /*
      * Parser for /proc/stat.  Reads the cpu time related columns
-     * and publishes them via ROS diagnostics
+     * and publishes them via ROS diagnostics.  The kernel activity
+     * counters following the cpu lines (context switches, forks,
+     * interrupts and the run queue) are read in the same pass and
+     * published with the totals.
      */
     public:
         typedef std::map<std::string, std::string> cputime;
@@ -45,8 +53,17 @@ class CpuTime {
 
         /*
          * Constructor
+         *
+         * @param files - Set /proc/stat is registered with and read from.
          */
-        CpuTime();
+        CpuTime(FileSet &files);
+
+        /*
+         * Read the latest value from /proc/stat.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int update();
 
         /*
          * Get the number of available processors.
@@ -56,23 +73,64 @@ class CpuTime {
         unsigned int nproc();
 
         /*
-         * Update the ROS diagnostics.
+         * Update the ROS diagnostics (sysmon node only).
          *
          * @param proc  - Value from -1 to nproc().  -1 represents the total usage
-         *              across all cpus/processors.
+         *              across all cpus/processors along with the kernel
+         *              activity counters.
          */
         void ros_update(int proc, diagnostic_updater::DiagnosticStatusWrapper &dsw);
 
+        /*
+         * Add the values read by the last update to a sink.
+         */
+        void record(Sink &sink) const;
+
     private:
         /*
-         * Read the latest value from /proc/stat.
+         * Parse one of the cpu lines from /proc/stat.
          *
-         * @return  - 0 on success, appropriate errno otherwise.
+         * @param line  - Start of a line starting with "cpu".
+         * @param eol   - End of the line.
          */
-        int update();
+        void parse_cpu(const char *line, const char *eol);
+
+        /*
+         * Parse one of the kernel activity lines from /proc/stat.
+         *
+         * @param line  - Start of a line that does not start with "cpu".
+         * @param eol   - End of the line.
+         */
+        void parse_activity(const char *line, const char *eol);
+
+        /*
+         * Convert the activity counters read by the last update() into rates.
+         */
+        void update_rates();
 
         std::vector<cputime> m_values;
+        std::vector<std::string> m_tasks;
         cputime              m_totals;
+
+        unsigned long long   m_ctxt;
+        unsigned long long   m_processes;
+        unsigned long long   m_intr;
+        unsigned long long   m_procs_running;
+        unsigned long long   m_procs_blocked;
+        double               m_run_queue;
+
+        unsigned long long   m_last_ctxt;
+        unsigned long long   m_last_processes;
+        unsigned long long   m_last_intr;
+        double               m_last;
+        unsigned long        m_last_cycle;
+
+        double               m_ctxt_rate;
+        double               m_fork_rate;
+        double               m_intr_rate;
+
+        FileSet *           m_files;
+        int                 m_source;
 };
 
 } // namespace sysmon
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "clock.hpp"
+#include "diagnosticpublisher.hpp"
+
+namespace sysmon {
+
+DiagnosticPublisher::DiagnosticPublisher(ros::NodeHandle &nh) :
+    m_publisher(nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1)),
+    m_period(1),
+    m_next(0)
+{
+    ros::param::get("~diagnostic_period", m_period);
+
+    /* Status names are prefixed with the node name, as the updater does */
+    m_prefix = ros::this_node::getName();
+    if (m_prefix.size() && m_prefix[0] == '/')
+        m_prefix.erase(0, 1);
+    m_prefix += ": ";
+}
+
+void DiagnosticPublisher::setHardwareID(const std::string &id)
+{
+    m_hardware_id = id;
+    for (unsigned int i = 0; i < m_statuses.size(); ++i)
+        m_statuses[i].hardware_id = id;
+}
+
+void DiagnosticPublisher::add(const std::string &name, const diagnostic_updater::TaskFunction &task)
+{
+    diagnostic_updater::DiagnosticStatusWrapper status;
+    status.name = m_prefix + name;
+    status.hardware_id = m_hardware_id;
+
+    m_tasks.push_back(task);
+    m_statuses.push_back(status);
+    m_array.status.resize(m_statuses.size());
+}
+
+void DiagnosticPublisher::update()
+{
+    double now = monotonic_seconds();
+    if (now < m_next)
+        return;
+    m_next = now + m_period;
+
+    for (unsigned int i = 0; i < m_tasks.size(); ++i) {
+        diagnostic_updater::DiagnosticStatusWrapper &status = m_statuses[i];
+
+        status.level = diagnostic_msgs::DiagnosticStatus::OK;
+        status.message.clear();
+        m_tasks[i](status);
+
+        m_array.status[i] = status;
+    }
+
+    m_array.header.stamp = ros::Time::now();
+    m_publisher.publish(m_array);
+}
+
+} // namespace sysmon
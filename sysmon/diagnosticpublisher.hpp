@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <diagnostic_updater/diagnostic_updater.h>
+#include <ros/ros.h>
+
+namespace sysmon {
+
+class DiagnosticPublisher {
+    /*
+     * Runs the diagnostic tasks and publishes their status on /diagnostics,
+     * in place of diagnostic_updater::Updater.  The updater builds a new
+     * status for every task and a new DiagnosticArray to copy them into on
+     * each update, on a large host that is thousands of strings.  Here each
+     * task keeps one status, and the array one copy of it, for the life of
+     * the node so the names, keys and values are written over storage that
+     * is already there (see StatusValues).
+     *
+     * ROS Parameters:
+     *
+     * ~/diagnostic_period: Seconds between updates, as for
+     *                      diagnostic_updater.  Default 1.
+     */
+    public:
+        /*
+         * Constructor
+         */
+        DiagnosticPublisher(ros::NodeHandle &nh);
+
+        /*
+         * Set the hardware id reported with every status.
+         */
+        void setHardwareID(const std::string &id);
+
+        /*
+         * Register a task, run on every update to fill in its status.
+         */
+        void add(const std::string &name, const diagnostic_updater::TaskFunction &task);
+
+        template <class T>
+        void add(const std::string &name, T *object,
+                void (T::*method)(diagnostic_updater::DiagnosticStatusWrapper &))
+        {
+            add(name, boost::bind(method, object, _1));
+        }
+
+        /*
+         * Run every task and publish, if the period has passed since the last
+         * update.
+         */
+        void update();
+
+    private:
+        std::vector<diagnostic_updater::TaskFunction> m_tasks;
+        std::vector<diagnostic_updater::DiagnosticStatusWrapper> m_statuses;
+        diagnostic_msgs::DiagnosticArray m_array;
+
+        ros::Publisher      m_publisher;
+        std::string         m_prefix;
+        std::string         m_hardware_id;
+        double              m_period;
+        double              m_next;
+};
+
+} // namespace sysmon
@@ -28,27 +28,62 @@
  */
 
 #include <cerrno>
-#include <cstdio>
-#include <mntent.h>
+#include <cstring>
 #include <sys/statvfs.h>
 
-#include <iostream>
-#include <fstream>
+#include <algorithm>
+#include <limits>
 #include <vector>
-#include <boost/algorithm/string.hpp>
 
+#include "clock.hpp"
 #include "diskusage.hpp"
+#include "log.hpp"
+#include "parse.hpp"
 
 namespace sysmon {
 
-DiskUsage::DiskUsage()
+namespace {
+
+/*
+ * Copy a field of /etc/mtab, undoing the octal escapes getmntent(3) would
+ * (a space in a mount point is written as \040).
+ */
+void unescape(std::string &dest, const char *p, const char *end)
+{
+    dest.clear();
+    while (p < end) {
+        if (*p == '\\' && end - p >= 4
+                && p[1] >= '0' && p[1] <= '3'
+                && p[2] >= '0' && p[2] <= '7'
+                && p[3] >= '0' && p[3] <= '7') {
+            dest += (char)((p[1] - '0') << 6 | (p[2] - '0') << 3 | (p[3] - '0'));
+            p += 4;
+        } else {
+            dest += *p++;
+        }
+    }
+}
+
+} // namespace
+
+DiskUsage::DiskUsage(FileSet &files, const std::set<std::string> &mountlist,
+        double window, double warn, double error) :
+    m_window(window > 0 ? window : 600),
+    m_warn(warn),
+    m_error(error),
+    m_mountlist(mountlist),
+    m_files(&files),
+    m_source(files.add("/etc/mtab"))
 {
+    m_slopes.reserve(NSAMPLES * (NSAMPLES - 1) / 2);
+
     /* Kernel pseudo? filesystems */
     m_fs_blacklist.insert("sysfs");
     m_fs_blacklist.insert("rootfs");
     m_fs_blacklist.insert("bdev");
     m_fs_blacklist.insert("proc");
     m_fs_blacklist.insert("cgroup");
+    m_fs_blacklist.insert("cgroup2");
     m_fs_blacklist.insert("cpuset");
     m_fs_blacklist.insert("tmpfs");
     m_fs_blacklist.insert("binfmt_misc");
@@ -75,8 +110,6 @@ DiskUsage::DiskUsage()
     m_fs_blacklist.insert("nfs4");
     m_fs_blacklist.insert("autofs");
     m_fs_blacklist.insert("nfsd");
-
-    fill_mountlist();
 }
 
 std::vector<std::string> DiskUsage::disks()
@@ -92,57 +125,74 @@ std::vector<std::string> DiskUsage::disks()
     return ret;
 }
 
-void DiskUsage::ros_update(const std::string &disk, diagnostic_updater::DiagnosticStatusWrapper &dsw)
+void DiskUsage::record(Sink &sink) const
 {
-    if (update()) {
-        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Update failed");
-        return;
-    }
+    for (std::map<std::string, diskusage>::const_iterator disk = m_values.begin();
+            disk != m_values.end();
+            ++disk) {
+        const std::string &task = (*m_tasks.find((*disk).first)).second;
 
-    if (m_values.find(disk) == m_values.end()) {
-        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Invalid disk name");
-        return;
+        for (diskusageIter it = (*disk).second.begin(); it != (*disk).second.end(); ++it)
+            sink.add(task, (*it).first, (*it).second);
     }
-
-    dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
-
-    for (diskusageIter it = m_values[disk].begin(); it != m_values[disk].end(); ++it)
-        dsw.add((*it).first, (*it).second);
 }
 
 int DiskUsage::update()
 {
-    FILE * mtab = NULL;
-    struct mntent * mnt;
-    char strings[4096];
-
-    mtab = setmntent("/etc/mtab", "r");
-    if (!mtab) {
-        int r = errno;
-        ROS_ERROR("%s:  Failed to open /etc/mtab, errno %d", __func__, r);
-        return r;
+    /* Looked up every cycle, longer keys would allocate a temporary each time */
+    static const std::string size_key("size");
+    static const std::string avail_key("avail");
+    static const std::string usage_key("usage");
+    static const std::string fill_rate_key("fill rate (B/s)");
+    static const std::string time_to_full_key("time to full (s)");
+    static const std::string inodes_key("inodes");
+    static const std::string inodes_avail_key("inodes avail");
+    static const std::string inode_usage_key("inode usage");
+
+    const char *data;
+    size_t len;
+
+    if (m_files->get(m_source, data, len)) {
+        log_error("%s:  Failed to read /etc/mtab", __func__);
+        return EIO;
     }
 
-    while ((mnt = getmntent(mtab))) {
+    /* /dev/sda1 / ext4 rw,noatime 0 0 */
+    const char *end = data + len;
+    for (const char *p = data; p < end; ++p) {
+        const char *eol = line_end(p, end);
+        const char *line = p;
+        const char *fsname, *dir, *dir_end, *type;
         struct statvfs fs;
         int r;
         fsblkcnt_t size;
         fsblkcnt_t avail;
         float usage;
 
-        if (!mnt->mnt_dir)
+        p = eol;
+
+        if (*line == '#'
+                || !next_word(line, eol, fsname)
+                || !next_word(line, eol, dir))
             continue;
+        dir_end = line;
+        if (!next_word(line, eol, type))
+            continue;
+
+        unescape(m_type, type, line);
+        unescape(m_dir, dir, dir_end);
 
         if (m_mountlist.size()) {
-            if (std::find(m_mountlist.begin(), m_mountlist.end(), mnt->mnt_dir) == m_mountlist.end())
+            if (m_mountlist.find(m_dir) == m_mountlist.end())
                 continue;
-        } else if (std::find(m_fs_blacklist.begin(), m_fs_blacklist.end(), mnt->mnt_type) != m_fs_blacklist.end()) {
+        } else if (m_fs_blacklist.find(m_type) != m_fs_blacklist.end()) {
             continue;
         }
 
-        r = statvfs(mnt->mnt_dir, &fs);
+        m_path.assign(m_files->root()).append(m_dir);
+        r = statvfs(m_path.c_str(), &fs);
         if (r) {
-            ROS_ERROR("%s:  statfs failed on %s, errno %d", __func__, mnt->mnt_dir, r);
+            log_error("%s:  statfs failed on %s, errno %d", __func__, m_path.c_str(), r);
             continue;
         }
 
@@ -150,39 +200,97 @@ int DiskUsage::update()
         avail = (fs.f_bavail / 1024) * fs.f_bsize;
         usage = (float)(fs.f_blocks - fs.f_bavail) / fs.f_blocks;
 
-        diskusage i;
-        i["size"] = boost::lexical_cast<std::string>(size);
-        i["avail"] = boost::lexical_cast<std::string>(avail);
-        i["usage"] = boost::lexical_cast<std::string>(100 * usage);
+        std::map<std::string, diskusage>::iterator it = m_values.find(m_dir);
+        if (it == m_values.end()) {
+            it = m_values.insert(std::make_pair(m_dir, diskusage())).first;
+            m_tasks.insert(std::make_pair(m_dir, "Disk Usage - " + m_dir));
 
-        if (m_values.find(mnt->mnt_dir) != m_values.end())
-            m_values[mnt->mnt_dir] = i;
-        else
-            m_values.insert(std::pair<std::string, diskusage>(mnt->mnt_dir, i));
+            history h;
+            memset(&h, 0, sizeof(h));
+            h.time_to_full = std::numeric_limits<double>::infinity();
+            m_history.insert(std::make_pair(m_dir, h));
+        }
+
+        /*
+         * Read-only mounts such as squashfs and iso9660, and pseudo
+         * filesystems without blocks, report nothing available.  They are
+         * not filling and never predicted full.
+         */
+        history &h = (*m_history.find(m_dir)).second;
+        if ((fs.f_flag & ST_RDONLY) || !fs.f_blocks) {
+            h.count = h.next = 0;
+            h.fill_rate = h.inode_rate = 0;
+            h.time_to_full = std::numeric_limits<double>::infinity();
+        } else {
+            follow(h, fs);
+        }
 
+        diskusage &i = (*it).second;
+        assign_format(i[size_key], "%llu", (unsigned long long)size);
+        assign_format(i[avail_key], "%llu", (unsigned long long)avail);
+        assign_format(i[usage_key], "%g", 100 * usage);
+        assign_format(i[fill_rate_key], "%g", h.fill_rate);
+        assign_format(i[time_to_full_key], "%g", h.time_to_full);
+
+        /* Filesystems without a fixed inode table report none */
+        if (fs.f_files) {
+            assign_format(i[inodes_key], "%llu", (unsigned long long)fs.f_files);
+            assign_format(i[inodes_avail_key], "%llu", (unsigned long long)fs.f_favail);
+            assign_format(i[inode_usage_key], "%g", 100.0 * (fs.f_files - fs.f_favail) / fs.f_files);
+        }
     }
-    endmntent(mtab);
+
     return 0;
 }
 
-void DiskUsage::fill_mountlist()
+void DiskUsage::follow(history &h, const struct statvfs &fs)
 {
-    if (!ros::param::has("~diskusage/mountlist"))
-        return;
-
-    XmlRpc::XmlRpcValue mountlist;
-    ros::param::get("~diskusage/mountlist", mountlist);
-    if (mountlist.getType() != XmlRpc::XmlRpcValue::TypeArray) {
-        ROS_ERROR("%s:  Invalid value (not TypeArray) for ~diskusage/mountlist", __func__);
-        return;
+    double now = monotonic_seconds();
+
+    if (h.count) {
+        unsigned int last = (h.next + NSAMPLES - 1) % NSAMPLES;
+        if (now - h.times[last] < m_window / NSAMPLES)
+            return;
     }
 
-    for (int i = 0; i < mountlist.size(); ++i) {
-        if (mountlist[i].getType() != XmlRpc::XmlRpcValue::TypeString)
-            continue;
+    h.times[h.next] = now;
+    h.used[h.next] = (double)(fs.f_blocks - fs.f_bfree) * fs.f_frsize;
+    h.inodes[h.next] = (double)(fs.f_files - fs.f_ffree);
+    h.next = (h.next + 1) % NSAMPLES;
+    if (h.count < NSAMPLES)
+        ++h.count;
+
+    h.fill_rate = slope(h, h.used);
+    h.inode_rate = slope(h, h.inodes);
+
+    double avail = (double)fs.f_bavail * fs.f_frsize;
+    h.time_to_full = std::numeric_limits<double>::infinity();
+    if (h.fill_rate > 0)
+        h.time_to_full = avail / h.fill_rate;
+    if (fs.f_files && h.inode_rate > 0)
+        h.time_to_full = std::min(h.time_to_full, fs.f_favail / h.inode_rate);
+    if (!fs.f_bavail || (fs.f_files && !fs.f_favail))
+        h.time_to_full = 0;
+}
 
-        m_mountlist.insert(static_cast<std::string>(mountlist[i]));
+double DiskUsage::slope(const history &h, const double *values)
+{
+    m_slopes.clear();
+    for (unsigned int i = 0; i < h.count; ++i) {
+        for (unsigned int j = i + 1; j < h.count; ++j) {
+            double dt = h.times[j] - h.times[i];
+            if (dt != 0)
+                m_slopes.push_back((values[j] - values[i]) / dt);
+        }
     }
+
+    /* Too short a history to tell */
+    if (m_slopes.size() < 3)
+        return 0;
+
+    std::vector<double>::iterator mid = m_slopes.begin() + m_slopes.size() / 2;
+    std::nth_element(m_slopes.begin(), mid, m_slopes.end());
+    return *mid;
 }
 
 } // namespace sysmon
@@ -29,8 +29,15 @@
 
 #pragma once
 
+#include <map>
+#include <set>
 #include <string>
-#include <diagnostic_updater/diagnostic_updater.h>
+#include <vector>
+#include <sys/statvfs.h>
+
+#include "diagnostics.hpp"
+#include "fileset.hpp"
+#include "sink.hpp"
 
 namespace sysmon {
 
@@ -42,11 +49,12 @@ class DiskUsage {
      * parameter.  If the mountlist is not specified then every filesystem that
      * is not of a type blacklisted will be monitored.
      *
-     * ROS Parameters:
-     *
-     * ~/diskusage/mountlist:   List of mountpoints that should be monitored if
-     *                          they are active.  This is a list of
-     *                          XmlRpcValue::TypeString.
+     * A short history of the used bytes and inodes of each mount is kept to
+     * estimate how fast it fills.  The slope is the median of the slopes
+     * between every pair of samples in the window (Theil-Sen), so a single
+     * large file written and deleted does not swing the estimate, and the
+     * time until the mount is out of space or inodes follows from it.
+     * Read-only mounts and those without blocks are skipped.
      */
     public:
         typedef std::map<std::string, std::string> diskusage;
@@ -54,8 +62,28 @@ class DiskUsage {
 
         /*
          * Constructor
+         *
+         * @param files     - Set /etc/mtab is registered with and read from.
+         * @param mountlist - Mountpoints to monitor if they are active,
+         *                    overriding the blacklist when not empty
+         *                    (~diskusage/mountlist in sysmon).
+         * @param window    - Seconds of history the fill rate is estimated
+         *                    over (~diskusage/window).
+         * @param warn      - Time to full in seconds below which to warn
+         *                    (~diskusage/warn_horizon).
+         * @param error     - Time to full in seconds below which to report
+         *                    an error (~diskusage/error_horizon).
+         */
+        DiskUsage(FileSet &files,
+                const std::set<std::string> &mountlist = std::set<std::string>(),
+                double window = 600, double warn = 86400, double error = 3600);
+
+        /*
+         * Poll the current disk usage.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
          */
-        DiskUsage();
+        int update();
 
         /*
          * Return list of disks that are being monitored.
@@ -63,25 +91,45 @@ class DiskUsage {
         std::vector<std::string> disks();
 
         /*
-         * Update the ROS diagnostics.
+         * Update the ROS diagnostics (sysmon node only).
          *
          * @param disk  - disk to publish statistics for.
          *
          */
         void ros_update(const std::string &disk, diagnostic_updater::DiagnosticStatusWrapper &dsw);
 
+        /*
+         * Add the values read by the last update to a sink.
+         */
+        void record(Sink &sink) const;
+
     private:
+        enum { NSAMPLES = 30 };
+
         /*
-         * Poll the current disk usage.
-         *
-         * @return  - 0 on success, appropriate errno otherwise.
+         * Ring of samples spaced window / NSAMPLES apart.
          */
-        int update();
+        struct history {
+            double              times[NSAMPLES];
+            double              used[NSAMPLES];
+            double              inodes[NSAMPLES];
+            unsigned int        count;
+            unsigned int        next;
+
+            double              fill_rate;
+            double              inode_rate;
+            double              time_to_full;
+        };
 
         /*
-         * Query parameter server for the list of mountpoints to monitor
+         * Add a sample to the history of a mount and refresh its estimates.
          */
-        void fill_mountlist();
+        void follow(history &h, const struct statvfs &fs);
+
+        /*
+         * Median of the slopes between every pair of samples.
+         */
+        double slope(const history &h, const double *values);
 
         /*
          * List of filesystem types we ignore.
@@ -90,7 +138,25 @@ class DiskUsage {
 
         std::map<std::string, diskusage> m_values;
 
+        /*
+         * Task name each mount point is recorded under, and scratch space
+         * for parsing /etc/mtab without allocating.
+         */
+        std::map<std::string, std::string> m_tasks;
+        std::string         m_dir;
+        std::string         m_type;
+        std::string         m_path;
+
+        std::map<std::string, history> m_history;
+        std::vector<double> m_slopes;
+        double              m_window;
+        double              m_warn;
+        double              m_error;
+
         std::set<std::string> m_mountlist;
+
+        FileSet *           m_files;
+        int                 m_source;
 };
 
 } // namespace sysmon
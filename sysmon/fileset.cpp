@@ -0,0 +1,452 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include <algorithm>
+
+#include "clock.hpp"
+#include "fileset.hpp"
+#include "log.hpp"
+
+namespace sysmon {
+
+namespace {
+
+/* NUL bytes kept after the contents of every buffer */
+const size_t pad = 8;
+
+/* Initial buffer size, grown as required to hold the whole file */
+const size_t initial_size = 4096;
+
+/* io_uring submission queue size, larger sets are read in several batches */
+const unsigned int ring_entries = 64;
+
+} // namespace
+
+FileSet::FileSet(bool uring, const std::string &root) :
+    m_root(root),
+    m_ring_fd(-1),
+    m_registered(false),
+    m_sq_entries(0),
+    m_cq_entries(0),
+    m_sq_ptr(NULL),
+    m_sq_size(0),
+    m_cq_ptr(NULL),
+    m_cq_size(0),
+    m_sqes(NULL),
+    m_sqes_size(0),
+    m_sq_head(NULL),
+    m_sq_tail(NULL),
+    m_sq_mask(NULL),
+    m_sq_array(NULL),
+    m_cq_head(NULL),
+    m_cq_tail(NULL),
+    m_cq_mask(NULL),
+    m_cqes(NULL),
+    m_cycle(0),
+    m_syscalls(0),
+    m_read_time(0)
+{
+    if (uring && setup_uring())
+        log_warn("%s:  io_uring unavailable, falling back to pread", __func__);
+}
+
+FileSet::~FileSet()
+{
+    teardown_uring();
+
+    for (std::vector<source>::iterator it = m_sources.begin(); it != m_sources.end(); ++it) {
+        if ((*it).fd >= 0)
+            close((*it).fd);
+    }
+}
+
+int FileSet::add(const std::string &p)
+{
+    for (unsigned int i = 0; i < m_sources.size(); ++i) {
+        if (m_sources[i].path == p)
+            return i;
+    }
+
+    int fd = open((m_root + p).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        int r = errno;
+        log_error("%s:  Failed to open %s, errno %d", __func__, p.c_str(), r);
+        return -r;
+    }
+
+    source s;
+    s.path = p;
+    s.fd = fd;
+    s.buf.resize(initial_size);
+    s.len = 0;
+    s.err = 0;
+    s.valid = false;
+    m_sources.push_back(s);
+
+    m_registered = false;
+
+    return m_sources.size() - 1;
+}
+
+int FileSet::read()
+{
+    double start = monotonic_seconds();
+    int ret = 0;
+
+    ++m_cycle;
+    m_syscalls = 0;
+
+    if (m_ring_fd >= 0)
+        ret = read_uring();
+
+    /* io_uring may have been torn down by read_uring() */
+    if (m_ring_fd < 0) {
+        for (std::vector<source>::iterator it = m_sources.begin(); it != m_sources.end(); ++it) {
+            int r = read_one(*it);
+            if (r)
+                ret = r;
+        }
+    }
+
+    m_read_time = monotonic_seconds() - start;
+
+    return ret;
+}
+
+int FileSet::get(int id, const char *&data, size_t &len)
+{
+    if (id < 0 || id >= (int)m_sources.size())
+        return EINVAL;
+
+    source &s = m_sources[id];
+    if (!s.valid && !s.err)
+        read_one(s);
+
+    if (!s.valid)
+        return s.err;
+
+    data = &s.buf[0];
+    len = s.len;
+    return 0;
+}
+
+const std::string & FileSet::path(int id) const
+{
+    static const std::string unknown;
+
+    if (id < 0 || id >= (int)m_sources.size())
+        return unknown;
+    return m_sources[id].path;
+}
+
+const std::string & FileSet::root() const
+{
+    return m_root;
+}
+
+unsigned long FileSet::cycle() const
+{
+    return m_cycle;
+}
+
+bool FileSet::uring() const
+{
+    return m_ring_fd >= 0;
+}
+
+unsigned long FileSet::syscalls() const
+{
+    return m_syscalls;
+}
+
+double FileSet::read_time() const
+{
+    return m_read_time;
+}
+
+int FileSet::read_one(source &s)
+{
+    size_t len = 0;
+
+    for (;;) {
+        if (s.buf.size() < len + initial_size + pad)
+            s.buf.resize(std::max(2 * s.buf.size(), len + initial_size + pad));
+
+        size_t space = s.buf.size() - len - pad;
+        ssize_t n = pread(s.fd, &s.buf[len], space, len);
+        ++m_syscalls;
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+
+            s.err = errno;
+            s.valid = false;
+            log_error("%s:  Failed to read %s, errno %d", __func__, s.path.c_str(), s.err);
+            return s.err;
+        }
+
+        len += n;
+
+        /*
+         * Kernel files are generated in a single pass that fills as much of
+         * the buffer as possible, a short read is the end of the file.
+         */
+        if ((size_t)n < space)
+            break;
+    }
+
+    memset(&s.buf[len], 0, pad);
+    s.len = len;
+    s.err = 0;
+    s.valid = true;
+
+    return 0;
+}
+
+#ifdef HAVE_IO_URING
+int FileSet::read_uring()
+{
+    if (!m_registered && register_files()) {
+        teardown_uring();
+        return 0;
+    }
+
+    struct io_uring_sqe *sqes = static_cast<struct io_uring_sqe *>(m_sqes);
+    struct io_uring_cqe *cqes = static_cast<struct io_uring_cqe *>(m_cqes);
+    int ret = 0;
+
+    for (unsigned int base = 0; base < m_sources.size(); base += m_sq_entries) {
+        unsigned int count = std::min<unsigned int>(m_sq_entries, m_sources.size() - base);
+        unsigned int tail = *m_sq_tail;
+
+        for (unsigned int i = 0; i < count; ++i) {
+            source &s = m_sources[base + i];
+            unsigned int index = tail & *m_sq_mask;
+            struct io_uring_sqe *sqe = &sqes[index];
+
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_READ;
+            sqe->flags = IOSQE_FIXED_FILE;
+            sqe->fd = base + i;
+            sqe->addr = (unsigned long)&s.buf[0];
+            sqe->len = s.buf.size() - pad;
+            sqe->off = 0;
+            sqe->user_data = base + i;
+
+            m_sq_array[index] = index;
+            ++tail;
+        }
+        __atomic_store_n(m_sq_tail, tail, __ATOMIC_RELEASE);
+
+        int r;
+        do {
+            r = syscall(__NR_io_uring_enter, m_ring_fd, count, count, IORING_ENTER_GETEVENTS, NULL, 0);
+        } while (r < 0 && errno == EINTR);
+        ++m_syscalls;
+
+        if (r < 0) {
+            log_error("%s:  io_uring_enter failed, errno %d, falling back to pread", __func__, errno);
+            teardown_uring();
+            return 0;
+        }
+
+        unsigned int head = *m_cq_head;
+        unsigned int reaped = 0;
+        bool unsupported = false;
+
+        while (reaped < count && head != __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe *cqe = &cqes[head & *m_cq_mask];
+            source &s = m_sources[cqe->user_data];
+
+            if (cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP) {
+                /* IORING_OP_READ needs 5.6 */
+                unsupported = true;
+            } else if (cqe->res < 0) {
+                s.err = -cqe->res;
+                s.valid = false;
+                ret = s.err;
+                log_error("%s:  Failed to read %s, errno %d", __func__, s.path.c_str(), s.err);
+            } else if ((size_t)cqe->res == s.buf.size() - pad) {
+                /* Buffer was filled, grow it and read the rest directly */
+                int e = read_one(s);
+                if (e)
+                    ret = e;
+            } else {
+                s.len = cqe->res;
+                memset(&s.buf[s.len], 0, pad);
+                s.err = 0;
+                s.valid = true;
+            }
+
+            ++head;
+            ++reaped;
+        }
+        __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+
+        if (unsupported) {
+            log_warn("%s:  IORING_OP_READ unsupported, falling back to pread", __func__);
+            teardown_uring();
+            return 0;
+        }
+    }
+
+    return ret;
+}
+
+int FileSet::setup_uring()
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+
+    m_ring_fd = syscall(__NR_io_uring_setup, ring_entries, &p);
+    if (m_ring_fd < 0)
+        return errno;
+
+    m_sq_entries = p.sq_entries;
+    m_cq_entries = p.cq_entries;
+    m_sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    m_cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    m_sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        m_sq_size = m_cq_size = std::max(m_sq_size, m_cq_size);
+
+    m_sq_ptr = mmap(NULL, m_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            m_ring_fd, IORING_OFF_SQ_RING);
+    if (m_sq_ptr == MAP_FAILED) {
+        m_sq_ptr = NULL;
+        int r = errno;
+        teardown_uring();
+        return r;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        m_cq_ptr = m_sq_ptr;
+    } else {
+        m_cq_ptr = mmap(NULL, m_cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                m_ring_fd, IORING_OFF_CQ_RING);
+        if (m_cq_ptr == MAP_FAILED) {
+            m_cq_ptr = NULL;
+            int r = errno;
+            teardown_uring();
+            return r;
+        }
+    }
+
+    m_sqes = mmap(NULL, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            m_ring_fd, IORING_OFF_SQES);
+    if (m_sqes == MAP_FAILED) {
+        m_sqes = NULL;
+        int r = errno;
+        teardown_uring();
+        return r;
+    }
+
+    char *sq = static_cast<char *>(m_sq_ptr);
+    char *cq = static_cast<char *>(m_cq_ptr);
+
+    m_sq_head = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+    m_sq_tail = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+    m_sq_mask = reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+    m_sq_array = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+    m_cq_head = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+    m_cq_tail = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+    m_cq_mask = reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+    m_cqes = cq + p.cq_off.cqes;
+
+    return 0;
+}
+
+void FileSet::teardown_uring()
+{
+    if (m_sqes)
+        munmap(m_sqes, m_sqes_size);
+    if (m_cq_ptr && m_cq_ptr != m_sq_ptr)
+        munmap(m_cq_ptr, m_cq_size);
+    if (m_sq_ptr)
+        munmap(m_sq_ptr, m_sq_size);
+    if (m_ring_fd >= 0)
+        close(m_ring_fd);
+
+    m_sqes = m_cq_ptr = m_sq_ptr = NULL;
+    m_ring_fd = -1;
+    m_registered = false;
+}
+
+int FileSet::register_files()
+{
+    std::vector<int> fds;
+    for (std::vector<source>::const_iterator it = m_sources.begin(); it != m_sources.end(); ++it)
+        fds.push_back((*it).fd);
+
+    /* Fails with ENXIO when nothing is registered yet, which is fine */
+    syscall(__NR_io_uring_register, m_ring_fd, IORING_UNREGISTER_FILES, NULL, 0);
+
+    if (fds.size() && syscall(__NR_io_uring_register, m_ring_fd, IORING_REGISTER_FILES, &fds[0], fds.size())) {
+        int r = errno;
+        log_error("%s:  Failed to register files with io_uring, errno %d", __func__, r);
+        return r;
+    }
+
+    m_registered = true;
+    return 0;
+}
+#else
+int FileSet::read_uring()
+{
+    return 0;
+}
+
+int FileSet::setup_uring()
+{
+    return ENOSYS;
+}
+
+void FileSet::teardown_uring()
+{}
+
+int FileSet::register_files()
+{
+    return ENOSYS;
+}
+#endif
+
+} // namespace sysmon
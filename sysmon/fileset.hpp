@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "diagnostics.hpp"
+
+namespace sysmon {
+
+class FileSet {
+    /*
+     * Set of kernel files read once per sample cycle on behalf of the
+     * collectors.  Each file is opened once when registered and held open,
+     * read() then refreshes every file into a preallocated buffer.  With the
+     * io_uring backend the whole set is submitted as a single batch against
+     * registered file descriptors, otherwise each file is read with pread().
+     *
+     * Buffers handed out by get() are always followed by at least 8 NUL bytes
+     * so parsers may load a machine word at a time without bounds checks.
+     */
+    public:
+        /*
+         * Constructor
+         *
+         * @param uring - Read files through io_uring when supported by the
+         *                kernel (~io/uring in sysmon).
+         * @param root  - Directory the registered paths are relative to, for
+         *                reading a copy of /proc and /etc rather than the
+         *                host's.  Empty for /.
+         */
+        FileSet(bool uring = false, const std::string &root = "");
+
+        ~FileSet();
+
+        /*
+         * Register a file to be read every cycle.  Registering the same
+         * path twice returns the same id.
+         *
+         * @return  - id to pass to get(), negative errno on failure.
+         */
+        int add(const std::string &path);
+
+        /*
+         * Read every registered file.
+         *
+         * @return  - 0 on success, errno of the last failure otherwise.
+         */
+        int read();
+
+        /*
+         * Get the contents of a file as of the last read().  A file that has
+         * not been read yet is read immediately.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int get(int id, const char *&data, size_t &len);
+
+        /*
+         * Get the path a file was registered with.
+         */
+        const std::string & path(int id) const;
+
+        /*
+         * Get the directory the paths are relative to.
+         */
+        const std::string & root() const;
+
+        /*
+         * Number of read() calls so far, lets collectors that are updated
+         * several times a cycle tell whether they are looking at new data.
+         */
+        unsigned long cycle() const;
+
+        /*
+         * Whether io_uring is being used.
+         */
+        bool uring() const;
+
+        /*
+         * Number of system calls the last read() made.
+         */
+        unsigned long syscalls() const;
+
+        /*
+         * Seconds the last read() took.
+         */
+        double read_time() const;
+
+        /*
+         * Update the ROS diagnostics (sysmon node only) with the cost of the last read().
+         */
+        void ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw);
+
+    private:
+        struct source {
+            std::string         path;
+            int                 fd;
+            std::vector<char>   buf;
+            size_t              len;
+            int                 err;
+            bool                valid;
+        };
+
+        /*
+         * Read a single file with pread(), growing its buffer until the
+         * whole file fits.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int read_one(source &s);
+
+        /*
+         * Read every file as io_uring batches of at most the ring size.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int read_uring();
+
+        int setup_uring();
+        void teardown_uring();
+        int register_files();
+
+        FileSet(const FileSet &);
+        FileSet & operator=(const FileSet &);
+
+        std::string         m_root;
+        std::vector<source> m_sources;
+
+        int                 m_ring_fd;
+        bool                m_registered;
+        unsigned int        m_sq_entries;
+        unsigned int        m_cq_entries;
+        void *              m_sq_ptr;
+        size_t              m_sq_size;
+        void *              m_cq_ptr;
+        size_t              m_cq_size;
+        void *              m_sqes;
+        size_t              m_sqes_size;
+
+        unsigned *          m_sq_head;
+        unsigned *          m_sq_tail;
+        unsigned *          m_sq_mask;
+        unsigned *          m_sq_array;
+        unsigned *          m_cq_head;
+        unsigned *          m_cq_tail;
+        unsigned *          m_cq_mask;
+        void *              m_cqes;
+
+        unsigned long       m_cycle;
+        unsigned long       m_syscalls;
+        double              m_read_time;
+};
+
+} // namespace sysmon
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <string>
+
+#include "parse.hpp"
+
+namespace sysmon {
+
+/*
+ * Formatting of values into existing strings, reusing their storage.  This
+ * is what diagnostic values are published as, integers are converted a
+ * digit at a time and other numbers are printed as %g would print them,
+ * without going through printf or a stream unless they are within an ulp
+ * of rounding the other way.
+ */
+
+inline void format_value(std::string &dest, unsigned long long value)
+{
+    char buf[24];
+    char *p = buf + sizeof(buf);
+
+    do {
+        *--p = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    dest.assign(p, buf + sizeof(buf) - p);
+}
+
+inline void format_value(std::string &dest, long long value)
+{
+    char buf[24];
+    char *p = buf + sizeof(buf);
+    unsigned long long u = value < 0 ? -(unsigned long long)value : value;
+
+    do {
+        *--p = '0' + u % 10;
+        u /= 10;
+    } while (u);
+
+    if (value < 0)
+        *--p = '-';
+
+    dest.assign(p, buf + sizeof(buf) - p);
+}
+
+inline void format_value(std::string &dest, double value)
+{
+    static const double scales[] = { 1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+    /* Most values are whole counts */
+    if (value > -1e15 && value < 1e15 && value == (long long)value) {
+        format_value(dest, (long long)value);
+        return;
+    }
+
+    /* Very large or small values, nan and inf */
+    double magnitude = fabs(value);
+    if (!(magnitude >= 1e-4 && magnitude < 1e15)) {
+        assign_format(dest, "%g", value);
+        return;
+    }
+
+    int exponent = 0;
+    for (double m = magnitude; m >= 10; m /= 10)
+        ++exponent;
+    for (double m = magnitude; m < 1; m *= 10)
+        --exponent;
+
+    /* The six significant digits as an integer, rounded once */
+    int shift = 5 - exponent;
+    double x = shift >= 0 ? magnitude * scales[shift] : magnitude / scales[-shift];
+    double floor_x = floor(x);
+    double half = x - floor_x - 0.5;
+
+    /*
+     * %g rounds the exact value half to even.  The scaling above can be off
+     * by an ulp, so leave values this close to a tie to printf, along with
+     * those rounding up to another digit or where the exponent was misjudged.
+     */
+    unsigned long long scaled = (unsigned long long)floor_x + (half > 0);
+    if (fabs(half) <= 4 * x * 2.2204460492503131e-16 || scaled < 100000 || scaled > 999999) {
+        assign_format(dest, "%g", value);
+        return;
+    }
+
+    char buf[48];
+    char *end = buf + sizeof(buf);
+    char *p = end;
+
+    /* Like %g, exponents of six and over are printed as 1.23457e+06 */
+    int decimals = shift;
+    if (exponent >= 6) {
+        for (int e = exponent; e; e /= 10)
+            *--p = '0' + e % 10;
+        if (exponent < 10)
+            *--p = '0';
+        *--p = '+';
+        *--p = 'e';
+        decimals = 5;
+    }
+
+    /* The fraction without its trailing zeros */
+    unsigned long long whole = (unsigned long long)scales[decimals];
+    unsigned long long fraction = scaled % whole;
+    for (; decimals && !(fraction % 10); --decimals)
+        fraction /= 10;
+    if (decimals) {
+        for (int i = 0; i < decimals; ++i) {
+            *--p = '0' + fraction % 10;
+            fraction /= 10;
+        }
+        *--p = '.';
+    }
+
+    unsigned long long integer = scaled / whole;
+    do {
+        *--p = '0' + integer % 10;
+        integer /= 10;
+    } while (integer);
+
+    if (value < 0)
+        *--p = '-';
+
+    dest.assign(p, end - p);
+}
+
+inline void format_value(std::string &dest, int value)
+{
+    format_value(dest, (long long)value);
+}
+
+inline void format_value(std::string &dest, long value)
+{
+    format_value(dest, (long long)value);
+}
+
+inline void format_value(std::string &dest, unsigned int value)
+{
+    format_value(dest, (unsigned long long)value);
+}
+
+inline void format_value(std::string &dest, unsigned long value)
+{
+    format_value(dest, (unsigned long long)value);
+}
+
+inline void format_value(std::string &dest, float value)
+{
+    format_value(dest, (double)value);
+}
+
+inline void format_value(std::string &dest, bool value)
+{
+    dest.assign(1, value ? '1' : '0');
+}
+
+inline void format_value(std::string &dest, char value)
+{
+    dest.assign(1, value);
+}
+
+inline void format_value(std::string &dest, const char *value)
+{
+    dest.assign(value);
+}
+
+inline void format_value(std::string &dest, const std::string &value)
+{
+    dest.assign(value);
+}
+
+} // namespace sysmon
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * sysmon_history - dump samples recorded by sysmon from a history file
+ * (see ~recorder/path).  The file may be read while sysmon is writing it.
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fnmatch.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "ringfile.hpp"
+
+namespace {
+
+void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [-l] [-s start] [-e end] [-m pattern]... file\n"
+            "\n"
+            "  -l          List the recorded series and exit\n"
+            "  -s start    First sample to dump, in seconds since the epoch\n"
+            "  -e end      Last sample to dump, in seconds since the epoch\n"
+            "  -m pattern  Only dump series matching the shell wildcard pattern\n"
+            "\n"
+            "Negative times are relative to the newest sample.  Samples are\n"
+            "printed one per line as <time> <series> <value> separated by tabs.\n",
+            argv0);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    bool list = false;
+    bool have_start = false;
+    bool have_end = false;
+    double start = 0;
+    double end = 0;
+    std::vector<std::string> patterns;
+    int c;
+
+    while ((c = getopt(argc, argv, "ls:e:m:h")) != -1) {
+        switch (c) {
+            case 'l':
+                list = true;
+                break;
+            case 's':
+                start = strtod(optarg, NULL);
+                have_start = true;
+                break;
+            case 'e':
+                end = strtod(optarg, NULL);
+                have_end = true;
+                break;
+            case 'm':
+                patterns.push_back(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    sysmon::RingFile ring;
+    int r = ring.open_readonly(argv[optind]);
+    if (r) {
+        fprintf(stderr, "%s: %s: %s\n", argv[0], argv[optind], strerror(r));
+        return 1;
+    }
+
+    std::vector<std::string> series = ring.series();
+    std::vector<unsigned int> blocks = ring.blocks();
+
+    if (list) {
+        for (unsigned int i = 0; i < series.size(); ++i)
+            printf("%s\n", series[i].c_str());
+        return 0;
+    }
+
+    std::vector<bool> selected(series.size(), patterns.empty());
+    for (unsigned int i = 0; i < series.size(); ++i) {
+        for (unsigned int j = 0; j < patterns.size(); ++j) {
+            if (!fnmatch(patterns[j].c_str(), series[i].c_str(), 0))
+                selected[i] = true;
+        }
+    }
+
+    std::vector<int64_t> times;
+    std::vector<double> values;
+    unsigned int nseries;
+
+    /* Relative times need the newest sample */
+    if ((have_start && start < 0) || (have_end && end < 0)) {
+        double newest = 0;
+
+        if (blocks.size() && !ring.decode(blocks.back(), times, values, nseries) && times.size())
+            newest = times.back() / 1000.0;
+
+        if (have_start && start < 0)
+            start += newest;
+        if (have_end && end < 0)
+            end += newest;
+    }
+
+    for (std::vector<unsigned int>::const_iterator it = blocks.begin(); it != blocks.end(); ++it) {
+        r = ring.decode(*it, times, values, nseries);
+        if (r) {
+            /* Reused by the writer since blocks() was called */
+            if (r != ENOENT)
+                fprintf(stderr, "%s: block %u: %s\n", argv[0], *it, strerror(r));
+            continue;
+        }
+
+        for (unsigned int frame = 0; frame < times.size(); ++frame) {
+            double t = times[frame] / 1000.0;
+
+            if ((have_start && t < start) || (have_end && t > end))
+                continue;
+
+            for (unsigned int i = 0; i < nseries && i < series.size(); ++i) {
+                double v = values[frame * nseries + i];
+
+                if (!selected[i] || std::isnan(v))
+                    continue;
+
+                printf("%lld.%03lld\t%s\t%.15g\n",
+                        (long long)(times[frame] / 1000), (long long)(times[frame] % 1000),
+                        series[i].c_str(), v);
+            }
+        }
+    }
+
+    return 0;
+}
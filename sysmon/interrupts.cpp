@@ -0,0 +1,344 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cerrno>
+#include <cstring>
+
+#include <sstream>
+
+#include "clock.hpp"
+#include "interrupts.hpp"
+#include "log.hpp"
+#include "parse.hpp"
+
+namespace sysmon {
+
+namespace {
+
+/*
+ * Space padding the kernel uses between columns, eight at a time.
+ */
+const uint64_t blanks = 0x2020202020202020ULL;
+
+const unsigned long long pow10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL };
+
+inline uint64_t load_word(const char *p)
+{
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+inline const char * skip_blanks(const char *p)
+{
+    while (load_word(p) == blanks)
+        p += 8;
+
+    while (*p == ' ' || *p == '\t')
+        ++p;
+
+    return p;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+/*
+ * Number of consecutive ascii digits at the start of w.  Each byte is tested
+ * in parallel, the high bit is stripped first so the additions can never
+ * carry into the neighbouring byte.
+ */
+inline unsigned int leading_digits(uint64_t w)
+{
+    const uint64_t high = 0x8080808080808080ULL;
+    uint64_t low = w & ~high;
+    uint64_t ge_0 = (low + 0x5050505050505050ULL) & high;
+    uint64_t gt_9 = (low + 0x4646464646464646ULL) & high;
+    uint64_t not_digit = (~(ge_0 & ~gt_9) | w) & high;
+
+    if (!not_digit)
+        return 8;
+    return __builtin_ctzll(not_digit) / 8;
+}
+
+/*
+ * Convert the first n (1-8) digits in w into an integer.  The digits are
+ * shifted up against the end of the word and the vacated bytes filled with
+ * '0' so that all eight bytes can be reduced with three multiplications.
+ */
+inline unsigned long long parse_digits(uint64_t w, unsigned int n)
+{
+    if (n < 8)
+        w = (w << (8 * (8 - n))) | (0x3030303030303030ULL >> (8 * n));
+
+    w -= 0x3030303030303030ULL;
+    w = (w * 10) + (w >> 8);
+    w = (((w & 0x000000FF000000FFULL) * 0x000F424000000064ULL)
+        + (((w >> 16) & 0x000000FF000000FFULL) * 0x0000271000000001ULL)) >> 32;
+    return w;
+}
+
+/*
+ * Parse the run of digits starting at p.
+ *
+ * @return  - Pointer to the first byte following the digits.
+ */
+inline const char * parse_counter(const char *p, unsigned long long &value)
+{
+    unsigned long long v = 0;
+    unsigned int n;
+
+    do {
+        n = leading_digits(load_word(p));
+        if (!n)
+            break;
+        v = v * pow10[n] + parse_digits(load_word(p), n);
+        p += n;
+    } while (n == 8);
+
+    value = v;
+    return p;
+}
+#else
+inline const char * parse_counter(const char *p, unsigned long long &value)
+{
+    unsigned long long v = 0;
+
+    while (*p >= '0' && *p <= '9')
+        v = v * 10 + (*p++ - '0');
+
+    value = v;
+    return p;
+}
+#endif
+
+inline bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+} // namespace
+
+Interrupts::Interrupts(FileSet &files, const std::string &path, const std::string &name,
+        double imbalance_ratio, double imbalance_min_rate) :
+    m_files(&files),
+    m_source(files.add(path)),
+    m_last_cycle(-1),
+    m_name(name),
+    m_total_task(name + " - Total"),
+    m_last(0),
+    m_have_last(false),
+    m_imbalance_ratio(imbalance_ratio),
+    m_imbalance_min_rate(imbalance_min_rate)
+{}
+
+unsigned int Interrupts::nproc()
+{
+    update();
+    return m_cpus.size();
+}
+
+unsigned int Interrupts::cpu(unsigned int column) const
+{
+    if (column >= m_cpus.size())
+        return column;
+    return m_cpus[column];
+}
+
+void Interrupts::record(Sink &sink) const
+{
+    for (std::vector<source>::const_iterator it = m_sources.begin(); it != m_sources.end(); ++it) {
+        double total = 0;
+        for (unsigned int i = 0; i < (*it).rates.size(); ++i) {
+            sink.add(m_tasks[i], (*it).key, (*it).rates[i]);
+            total += (*it).rates[i];
+        }
+        sink.add(m_total_task, (*it).key, total);
+    }
+
+    for (unsigned int i = 0; i < m_cpu_rates.size(); ++i)
+        sink.add(m_total_task, m_cpu_keys[i], m_cpu_rates[i]);
+}
+
+int Interrupts::update()
+{
+    /* Every task updates, only the first update of a cycle sees new counters */
+    if (m_files->cycle() == m_last_cycle)
+        return 0;
+
+    const char *data;
+    size_t len;
+    int r = m_files->get(m_source, data, len);
+    if (r) {
+        log_error("%s:  Failed to read %s", __func__, m_files->path(m_source).c_str());
+        return r;
+    }
+    m_last_cycle = m_files->cycle();
+
+    double now = monotonic_seconds();
+    double dt = m_have_last ? now - m_last : 0;
+
+    const char *p = data;
+    const char *end = data + len;
+
+    p = parse_header(p, end);
+
+    m_cpu_rates.assign(m_cpus.size(), 0);
+
+    unsigned int row = 0;
+    while (p < end) {
+        const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!eol)
+            eol = end;
+
+        p = skip_blanks(p);
+        const char *colon = static_cast<const char *>(memchr(p, ':', eol - p));
+        if (!colon) {
+            p = eol + 1;
+            continue;
+        }
+
+        if (row >= m_sources.size())
+            m_sources.push_back(source());
+        source &src = m_sources[row++];
+
+        bool fresh = !m_have_last || src.name.compare(0, std::string::npos, p, colon - p);
+        if (fresh) {
+            src.name.assign(p, colon - p);
+            src.desc.clear();
+            src.counts.clear();
+            src.rates.clear();
+        }
+
+        p = colon + 1;
+        unsigned int col;
+        for (col = 0; col < m_cpus.size(); ++col) {
+            p = skip_blanks(p);
+            if (p >= eol || !is_digit(*p))
+                break;
+
+            unsigned long long v;
+            p = parse_counter(p, v);
+
+            if (col >= src.counts.size()) {
+                src.counts.push_back(v);
+                src.rates.push_back(0);
+                continue;
+            }
+
+            double rate = 0;
+            if (!fresh && dt > 0 && v >= src.counts[col])
+                rate = (v - src.counts[col]) / dt;
+
+            src.counts[col] = v;
+            src.rates[col] = rate;
+            m_cpu_rates[col] += rate;
+        }
+        src.counts.resize(col);
+        src.rates.resize(col);
+
+        if (fresh) {
+            const char *desc = p;
+            const char *desc_end = eol;
+
+            trim(desc, desc_end);
+            src.desc.assign(desc, desc_end - desc);
+
+            src.key = src.name;
+            if (src.desc.size())
+                src.key += " (" + src.desc + ")";
+        }
+
+        p = eol + 1;
+    }
+    m_sources.resize(row);
+
+    m_imbalanced.clear();
+    if (m_cpus.size() > 1) {
+        double mean = 0;
+        for (unsigned int i = 0; i < m_cpu_rates.size(); ++i)
+            mean += m_cpu_rates[i];
+        mean /= m_cpu_rates.size();
+
+        for (unsigned int i = 0; i < m_cpu_rates.size(); ++i) {
+            if (m_cpu_rates[i] > m_imbalance_min_rate && m_cpu_rates[i] > m_imbalance_ratio * mean)
+                m_imbalanced.push_back(i);
+        }
+    }
+
+    m_last = now;
+    m_have_last = true;
+
+    return 0;
+}
+
+const char * Interrupts::parse_header(const char *p, const char *end)
+{
+    const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+    if (!eol)
+        eol = end;
+
+    const char *next = eol < end ? eol + 1 : end;
+
+    /* The cpus only change with hotplug */
+    if (m_header.size() && !m_header.compare(0, std::string::npos, p, eol - p))
+        return next;
+    m_header.assign(p, eol - p);
+
+    /* Counts saved against the old columns would give bogus rates */
+    m_have_last = false;
+    for (std::vector<source>::iterator it = m_sources.begin(); it != m_sources.end(); ++it) {
+        (*it).counts.clear();
+        (*it).rates.clear();
+    }
+
+    m_cpus.clear();
+    m_cpu_keys.clear();
+    m_tasks.clear();
+    for (;;) {
+        p = skip_blanks(p);
+        if (p + 3 >= eol || strncmp(p, "CPU", 3))
+            break;
+
+        unsigned long long id;
+        p = parse_counter(p + 3, id);
+        m_cpus.push_back(id);
+
+        std::ostringstream key;
+        key << "CPU" << id;
+        m_cpu_keys.push_back(key.str());
+
+        std::ostringstream task;
+        task << m_name << " - Processor " << id;
+        m_tasks.push_back(task.str());
+    }
+
+    return next;
+}
+
+} // namespace sysmon
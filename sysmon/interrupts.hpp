@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "diagnostics.hpp"
+#include "fileset.hpp"
+#include "sink.hpp"
+
+namespace sysmon {
+
+class Interrupts {
+    /*
+     * Parser for the per-cpu interrupt tables, /proc/interrupts and
+     * /proc/softirqs.  Both files share the same layout, a header naming the
+     * online cpus followed by one row of counters per source, so a single
+     * instance is created for each.  Counters are converted into per second
+     * rates and published via ROS diagnostics.  A cpu servicing a
+     * disproportionate share of the interrupts raises a warning.
+     *
+     * These tables are very wide on many-core hosts so the counters are
+     * scanned a machine word at a time, relying on the padding FileSet
+     * guarantees after each buffer.  The header and the keys of each source
+     * are only rebuilt when they change.
+     */
+    public:
+        struct source {
+            std::string                     name;
+            std::string                     desc;
+            std::string                     key;
+            std::vector<unsigned long long> counts;
+            std::vector<double>             rates;
+        };
+
+        /*
+         * Constructor
+         *
+         * @param files             - Set the table is registered with and
+         *                            read from.
+         * @param path              - Table to parse, /proc/interrupts or
+         *                            /proc/softirqs.
+         * @param name              - Prefix of the task names, for example
+         *                            "Interrupts" for "Interrupts - Total".
+         * @param imbalance_ratio   - A cpu whose rate exceeds the mean rate
+         *                            across all cpus by this factor is flagged
+         *                            as imbalanced
+         *                            (~interrupts/imbalance_ratio in sysmon).
+         * @param imbalance_min_rate - Per second rate a cpu must exceed before
+         *                            it is considered for the imbalance check
+         *                            (~interrupts/imbalance_min_rate in sysmon).
+         */
+        Interrupts(FileSet &files, const std::string &path, const std::string &name,
+                double imbalance_ratio = 4.0, double imbalance_min_rate = 1000.0);
+
+        /*
+         * Read the latest values from the table and compute rates.  Only the
+         * first update after each FileSet::read() parses the table.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int update();
+
+        /*
+         * Get the number of cpus listed in the table.
+         *
+         * @return  - number of online processors.
+         */
+        unsigned int nproc();
+
+        /*
+         * Get the processor id of a column in the table.  Offline cpus are not
+         * listed so this may differ from the column index.
+         *
+         * @param column    - Value from 0 to nproc() - 1.
+         */
+        unsigned int cpu(unsigned int column) const;
+
+        /*
+         * Update the ROS diagnostics (sysmon node only).
+         *
+         * @param proc  - Column from -1 to nproc() - 1.  -1 represents the total
+         *              rate of each source across all cpus and updates the
+         *              table, the per processor tasks publish the rates from
+         *              that same sample so must be registered after it.
+         */
+        void ros_update(int proc, diagnostic_updater::DiagnosticStatusWrapper &dsw);
+
+        /*
+         * Add the rates computed by the last update to a sink.
+         */
+        void record(Sink &sink) const;
+
+    private:
+        /*
+         * Parse the header line listing the online cpus.  When they change
+         * the saved counts are dropped and rates start over.
+         *
+         * @return  - Pointer to the start of the first row.
+         */
+        const char * parse_header(const char *p, const char *end);
+
+        FileSet *           m_files;
+        int                 m_source;
+        unsigned long       m_last_cycle;
+
+        std::string                 m_name;
+        std::string                 m_total_task;
+        std::string                 m_header;
+        std::vector<unsigned int>   m_cpus;
+        std::vector<std::string>    m_cpu_keys;
+        std::vector<std::string>    m_tasks;
+        std::vector<source>         m_sources;
+        std::vector<double>         m_cpu_rates;
+        std::vector<unsigned int>   m_imbalanced;
+
+        double              m_last;
+        bool                m_have_last;
+
+        double              m_imbalance_ratio;
+        double              m_imbalance_min_rate;
+};
+
+} // namespace sysmon
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include <algorithm>
+#include <sstream>
+#include <boost/bind.hpp>
+
+#include "latency.hpp"
+#include "rosadapter.hpp"
+#include "status.hpp"
+
+namespace sysmon {
+
+namespace {
+
+/*
+ * Histogram bucket a latency in microseconds is counted in.
+ */
+unsigned int bucket(unsigned long us)
+{
+    if (us < 100)
+        return us;
+
+    unsigned int index = 100;
+    unsigned long low = 100;
+    unsigned long width = 10;
+    for (unsigned int decade = 0; decade < 4; ++decade) {
+        if (us < low * 10)
+            return index + (us - low) / width;
+        index += 90;
+        low *= 10;
+        width *= 10;
+    }
+
+    return index;
+}
+
+/*
+ * First latency past a bucket, in microseconds.
+ */
+unsigned long bucket_limit(unsigned int index)
+{
+    if (index < 100)
+        return index + 1;
+
+    unsigned long low = 100;
+    unsigned long width = 10;
+    for (index -= 100; index >= 90; index -= 90) {
+        low *= 10;
+        width *= 10;
+    }
+
+    return low + (index + 1) * width;
+}
+
+} // namespace
+
+Latency::Latency() :
+    m_running(false),
+    m_interval(0),
+    m_priority(0),
+    m_warn(1000),
+    m_error(10000)
+{
+    ros::param::get("~latency/interval", m_interval);
+    ros::param::get("~latency/priority", m_priority);
+    ros::param::get("~latency/warn", m_warn);
+    ros::param::get("~latency/error", m_error);
+
+    if (m_interval <= 0)
+        return;
+
+    std::vector<int> cpus;
+    if (param_cpus("~latency/cpus", cpus) || cpus.empty())
+        cpus.assign(1, -1);
+
+    for (unsigned int i = 0; i < cpus.size(); ++i) {
+        probe *p = new probe();
+        p->cpu = cpus[i];
+        m_probes.push_back(p);
+    }
+
+    m_running = true;
+    for (unsigned int i = 0; i < m_probes.size(); ++i)
+        m_threads.create_thread(boost::bind(&Latency::run, this, m_probes[i]));
+}
+
+Latency::~Latency()
+{
+    m_running = false;
+    m_threads.join_all();
+
+    for (unsigned int i = 0; i < m_probes.size(); ++i)
+        delete m_probes[i];
+}
+
+unsigned int Latency::nprobes() const
+{
+    return m_probes.size();
+}
+
+int Latency::cpu(unsigned int probe) const
+{
+    if (probe >= m_probes.size())
+        return -1;
+    return m_probes[probe]->cpu;
+}
+
+void Latency::ros_update(unsigned int id, diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+
+    if (id >= m_probes.size()) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Unknown probe id");
+        return;
+    }
+
+    probe *p = m_probes[id];
+
+    unsigned long max = __sync_lock_test_and_set(&p->max, 0);
+    unsigned long misses = p->misses - p->last_misses;
+    p->last_misses += misses;
+
+    unsigned long counts[NBUCKETS];
+    unsigned long samples = 0;
+    for (unsigned int i = 0; i < NBUCKETS; ++i) {
+        counts[i] = p->counts[i] - p->last_counts[i];
+        p->last_counts[i] += counts[i];
+        samples += counts[i];
+    }
+
+    /* Upper edge of the bucket holding the 99th percentile, at most max */
+    unsigned long p99 = 0;
+    unsigned long below = 0;
+    for (unsigned int i = 0; i < NBUCKETS && samples; ++i) {
+        below += counts[i];
+        if (below * 100 >= samples * 99) {
+            p99 = std::min(bucket_limit(i), max);
+            break;
+        }
+    }
+
+    if (p->err) {
+        std::ostringstream s;
+        s << "Failed to set up probe: " << strerror(p->err);
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::WARN, s.str());
+    } else if (m_error > 0 && max >= (unsigned long)m_error) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Scheduling latency too high");
+    } else if (m_warn > 0 && max >= (unsigned long)m_warn) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Scheduling latency high");
+    } else {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+    }
+
+    values.add("interval (us)", m_interval);
+    values.add("samples", samples);
+    values.add("max (us)", max);
+    values.add("p99 (us)", p99);
+    values.add("missed deadlines", misses);
+}
+
+void Latency::run(probe *p)
+{
+    if (p->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(p->cpu, &set);
+        if ((p->err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set))) {
+            ROS_ERROR("%s:  Failed to pin probe to cpu %d, errno %d", __func__, p->cpu, p->err);
+            return;
+        }
+    }
+
+    if (m_priority > 0) {
+        struct sched_param param;
+        param.sched_priority = m_priority;
+        if ((p->err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)))
+            ROS_ERROR("%s:  Failed to set SCHED_FIFO priority %d, errno %d", __func__, m_priority, p->err);
+    }
+
+    const long long interval = m_interval * 1000LL;
+    struct timespec next;
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (m_running) {
+        next.tv_nsec += interval;
+        while (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            ++next.tv_sec;
+        }
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+            ;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        long long late = (now.tv_sec - next.tv_sec) * 1000000000LL + (now.tv_nsec - next.tv_nsec);
+        if (late < 0)
+            late = 0;
+
+        unsigned long us = late / 1000;
+        ++p->counts[bucket(us)];
+
+        unsigned long max = p->max;
+        while (us > max && !__sync_bool_compare_and_swap(&p->max, max, us))
+            max = p->max;
+
+        /* Skip the deadlines already missed rather than waking for each */
+        if (late >= interval) {
+            long long missed = late / interval;
+            p->misses += missed;
+            next.tv_sec += missed * interval / 1000000000;
+            next.tv_nsec += missed * interval % 1000000000;
+        }
+    }
+}
+
+} // namespace sysmon
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <vector>
+#include <boost/thread.hpp>
+#include <diagnostic_updater/diagnostic_updater.h>
+
+namespace sysmon {
+
+class Latency {
+    /*
+     * Measures how late threads wake up, in the spirit of cyclictest.  A
+     * probe thread sleeps until an absolute deadline with clock_nanosleep
+     * and records how far past the deadline it woke into a fixed-bucket
+     * histogram.  Optionally one probe is pinned to each of a list of cpus.
+     *
+     * Every update publishes the maximum and 99th percentile latency and
+     * the number of deadlines missed (woke a whole interval or more late)
+     * since the previous update.
+     *
+     * ROS Parameters:
+     *
+     * ~/latency/interval:  Probe period in microseconds, for example 1000.
+     *                      Default 0, disabled.
+     *
+     * ~/latency/cpus:      List of cpus to run one pinned probe on each.
+     *                      Default empty, a single unpinned probe.
+     *
+     * ~/latency/priority:  SCHED_FIFO priority of the probes, 0 keeps the
+     *                      policy of the node.  Default 0.
+     *
+     * ~/latency/warn:      Maximum latency in microseconds above which to
+     *                      warn.  Default 1000.
+     *
+     * ~/latency/error:     Maximum latency in microseconds above which to
+     *                      report an error.  Default 10000.
+     */
+    public:
+        /*
+         * Constructor
+         */
+        Latency();
+
+        ~Latency();
+
+        /*
+         * Number of probes running.
+         */
+        unsigned int nprobes() const;
+
+        /*
+         * Cpu a probe is pinned to, -1 if it is not pinned.
+         */
+        int cpu(unsigned int probe) const;
+
+        /*
+         * Update the ROS diagnostics.
+         *
+         * @param probe - Value from 0 to nprobes() - 1.
+         */
+        void ros_update(unsigned int probe, diagnostic_updater::DiagnosticStatusWrapper &dsw);
+
+    private:
+        /*
+         * 1us buckets below 100us, then 90 buckets per decade up to 1s.  The
+         * last bucket counts everything later than that.
+         */
+        enum { NBUCKETS = 100 + 4 * 90 + 1 };
+
+        /*
+         * Counters are only written by the probe thread and only read by
+         * ros_update().  max is reset by the reader, so it is updated with
+         * atomic builtins.
+         */
+        struct probe {
+            int                         cpu;
+            int                         err;
+            volatile unsigned long      counts[NBUCKETS];
+            volatile unsigned long      misses;
+            volatile unsigned long      max;
+
+            unsigned long               last_counts[NBUCKETS];
+            unsigned long               last_misses;
+        };
+
+        /*
+         * Probe thread, wakes every interval until m_running is cleared.
+         */
+        void run(probe *p);
+
+        Latency(const Latency &);
+        Latency & operator=(const Latency &);
+
+        std::vector<probe *>    m_probes;
+        boost::thread_group     m_threads;
+        volatile bool           m_running;
+
+        int                     m_interval;
+        int                     m_priority;
+        int                     m_warn;
+        int                     m_error;
+};
+
+} // namespace sysmon
@@ -29,59 +29,50 @@
 
 #include <cerrno>
 
-#include <iostream>
-#include <fstream>
-#include <boost/algorithm/string.hpp>
-
 #include "loadavg.hpp"
+#include "log.hpp"
+#include "parse.hpp"
 
 namespace sysmon {
 
-LoadAvg::LoadAvg()
+LoadAvg::LoadAvg(FileSet &files) :
+    m_files(&files),
+    m_source(files.add("/proc/loadavg"))
 {}
 
-void LoadAvg::ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw)
+void LoadAvg::record(Sink &sink) const
 {
-    if (update() || m_load.size() < 3) {
-        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Update failed");
-        return;
-    }
-
-    dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
-    static const char * names[] = {"1 minute", "5 minute", "15 minute"};
+    static const std::string task("Load Average");
+    static const std::string names[] = {"1 minute", "5 minute", "15 minute"};
 
-    for (unsigned int i = 0; i < 3; ++i)
-        dsw.add(names[i], m_load[i]);
+    for (unsigned int i = 0; i < 3 && i < m_load.size(); ++i)
+        sink.add(task, names[i], m_load[i]);
 }
 
 int LoadAvg::update()
 {
-    std::ifstream fp("/proc/loadavg");
-
-    if (!fp.is_open()) {
-        ROS_ERROR("%s:  Failed to open /proc/loadavg", __func__);
+    const char *data;
+    size_t len;
+    if (m_files->get(m_source, data, len)) {
+        log_error("%s:  Failed to read /proc/loadavg", __func__);
         return EIO;
     }
 
-    std::string line;
-    while (fp.good()) {
-        getline(fp, line);
+    /* 0.20 0.18 0.12 1/80 11206 */
+    const char *p = data;
+    const char *end = line_end(data, data + len);
+    const char *words[3];
+    size_t lengths[3];
 
-        std::list<std::string> res;
-        boost::algorithm::split(res, line, boost::is_any_of(" \t"));
-
-        if (res.size() < 3)
-            continue;
-
-        while (res.size() > 3)
-            res.pop_back();
-
-        m_load.clear();
-        for (std::list<std::string>::const_iterator it = res.begin(); it != res.end(); ++it)
-            m_load.push_back(*it);
+    for (unsigned int i = 0; i < 3; ++i) {
+        if (!next_word(p, end, words[i]))
+            return 0;
+        lengths[i] = p - words[i];
     }
 
-    fp.close();
+    m_load.resize(3);
+    for (unsigned int i = 0; i < 3; ++i)
+        m_load[i].assign(words[i], lengths[i]);
 
     return 0;
 }
@@ -31,7 +31,10 @@
 
 #include <string>
 #include <vector>
-#include <diagnostic_updater/diagnostic_updater.h>
+
+#include "diagnostics.hpp"
+#include "fileset.hpp"
+#include "sink.hpp"
 
 namespace sysmon {
 
@@ -43,15 +46,11 @@ class LoadAvg {
     public:
         /*
          * Constructor
+         *
+         * @param files - Set /proc/loadavg is registered with and read from.
          */
-        LoadAvg();
-
-        /*
-         * Update the ROS diagnostics.
-         */
-        void ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw);
+        LoadAvg(FileSet &files);
 
-    private:
         /*
          * Read the latest value from /proc/loadavg
          *
@@ -59,7 +58,21 @@ class LoadAvg {
          */
         int update();
 
+        /*
+         * Update the ROS diagnostics (sysmon node only).
+         */
+        void ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw);
+
+        /*
+         * Add the values read by the last update to a sink.
+         */
+        void record(Sink &sink) const;
+
+    private:
         std::vector<std::string> m_load;
+
+        FileSet *           m_files;
+        int                 m_source;
 };
 
 } // namespace sysmon
@@ -32,15 +32,34 @@
 
 #include "cpuinfo.hpp"
 #include "cputime.hpp"
+#include "diagnosticpublisher.hpp"
 #include "diskusage.hpp"
+#include "fileset.hpp"
+#include "interrupts.hpp"
+#include "latency.hpp"
 #include "loadavg.hpp"
 #include "meminfo.hpp"
+#include "netstat.hpp"
+#include "numa.hpp"
+#include "perf.hpp"
+#include "power.hpp"
+#include "processes.hpp"
+#include "prometheus.hpp"
+#include "realtime.hpp"
+#include "recorder.hpp"
+#include "resources.hpp"
+#include "rosadapter.hpp"
+#include "rules.hpp"
+#include "sampler.hpp"
+#include "snapshotwriter.hpp"
+#include "vmstat.hpp"
+#include "watchlist.hpp"
 
 int main(int argc, char **argv)
 {
     ros::init(argc, argv, "sysmon");
     ros::NodeHandle nh;
-    diagnostic_updater::Updater updater;
+    sysmon::DiagnosticPublisher updater(nh);
 
     char hostname[HOST_NAME_MAX];
     int r = gethostname(hostname, HOST_NAME_MAX-1);
@@ -49,7 +68,25 @@ int main(int argc, char **argv)
     else
         updater.setHardwareID(hostname);
 
-    sysmon::CpuInfo cpuinfo;
+    sysmon::set_log_handler(sysmon::ros_log);
+
+    /*
+     * Applied to the threads roscpp has started, those started from here on
+     * inherit the settings.
+     */
+    sysmon::RealTime realtime;
+    updater.add("Real Time", &realtime, &sysmon::RealTime::ros_update);
+
+    bool uring = false;
+    ros::param::get("~io/uring", uring);
+
+    sysmon::FileSet files(uring);
+    updater.add("I/O", &files, &sysmon::FileSet::ros_update);
+
+    /* Raises the status of the tasks registered through it */
+    sysmon::Rules rules;
+
+    sysmon::CpuInfo cpuinfo(files, sysmon::param_list("~cpuinfo/whitelist"));
     unsigned int nproc = cpuinfo.nproc();
 
     for (unsigned int i = 0; i < nproc; ++i) {
@@ -58,32 +95,163 @@ int main(int argc, char **argv)
         updater.add(s.str(), boost::bind(&sysmon::CpuInfo::ros_update, cpuinfo, i, _1));
     }
 
-    sysmon::LoadAvg loadavg;
-    updater.add("Load Average", &loadavg, &sysmon::LoadAvg::ros_update);
+    sysmon::LoadAvg loadavg(files);
+    rules.add(updater, "Load Average", boost::bind(&sysmon::LoadAvg::ros_update, &loadavg, _1));
+
+    sysmon::MemInfo meminfo(files, sysmon::param_list("~meminfo/whitelist"));
+    rules.add(updater, "Memory", boost::bind(&sysmon::MemInfo::ros_update, &meminfo, _1));
+
+    double retrans_warn = 5, drops_warn = 1;
+    ros::param::get("~net/retrans_warn", retrans_warn);
+    ros::param::get("~net/drops_warn", drops_warn);
+
+    sysmon::NetStat netstat(files, retrans_warn, drops_warn);
+    updater.add("Network Protocols", &netstat, &sysmon::NetStat::ros_update);
+
+    sysmon::Resources resources(files);
+    updater.add("Kernel Resources", &resources, &sysmon::Resources::ros_update);
+
+    sysmon::Numa numa(files);
+    std::vector<unsigned int> nodes = numa.nodes();
+    for (std::vector<unsigned int>::const_iterator it = nodes.begin(); it != nodes.end(); ++it) {
+        std::ostringstream s;
+        s << "Memory - Node " << (*it);
+        updater.add(s.str(), boost::bind(&sysmon::Numa::ros_update, &numa, *it, _1));
+    }
 
-    sysmon::MemInfo meminfo;
-    updater.add("Memory", &meminfo, &sysmon::MemInfo::ros_update);
+    sysmon::VmStat vmstat(files);
+    updater.add("Paging", &vmstat, &sysmon::VmStat::ros_update);
 
-    sysmon::CpuTime cputime;
-    updater.add("CPU Time - Total", boost::bind(&sysmon::CpuTime::ros_update, cputime, -1, _1));
+    sysmon::Power power(files);
+    updater.add("Power", &power, &sysmon::Power::ros_update);
+
+    sysmon::CpuTime cputime(files);
+    rules.add(updater, "CPU Time - Total", boost::bind(&sysmon::CpuTime::ros_update, &cputime, -1, _1));
 
     nproc = cputime.nproc();
     for (unsigned int i = 0; i < nproc; ++i) {
         std::ostringstream s;
         s << "Cpu Time - Processor " << i;
-        updater.add(s.str(), boost::bind(&sysmon::CpuTime::ros_update, cputime, i, _1));
+        rules.add(updater, s.str(), boost::bind(&sysmon::CpuTime::ros_update, &cputime, i, _1));
+    }
+
+    double imbalance_ratio = 4.0, imbalance_min_rate = 1000;
+    ros::param::get("~interrupts/imbalance_ratio", imbalance_ratio);
+    ros::param::get("~interrupts/imbalance_min_rate", imbalance_min_rate);
+
+    sysmon::Interrupts interrupts(files, "/proc/interrupts", "Interrupts",
+            imbalance_ratio, imbalance_min_rate);
+    updater.add("Interrupts - Total", boost::bind(&sysmon::Interrupts::ros_update, &interrupts, -1, _1));
+
+    nproc = interrupts.nproc();
+    for (unsigned int i = 0; i < nproc; ++i) {
+        std::ostringstream s;
+        s << "Interrupts - Processor " << interrupts.cpu(i);
+        updater.add(s.str(), boost::bind(&sysmon::Interrupts::ros_update, &interrupts, i, _1));
+    }
+
+    sysmon::Interrupts softirqs(files, "/proc/softirqs", "Softirqs",
+            imbalance_ratio, imbalance_min_rate);
+    updater.add("Softirqs - Total", boost::bind(&sysmon::Interrupts::ros_update, &softirqs, -1, _1));
+
+    nproc = softirqs.nproc();
+    for (unsigned int i = 0; i < nproc; ++i) {
+        std::ostringstream s;
+        s << "Softirqs - Processor " << softirqs.cpu(i);
+        updater.add(s.str(), boost::bind(&sysmon::Interrupts::ros_update, &softirqs, i, _1));
+    }
+
+    sysmon::PerfCounters perf;
+    if (perf.enabled()) {
+        updater.add("Perf Counters - Total", boost::bind(&sysmon::PerfCounters::ros_update, &perf, -1, _1));
+
+        for (unsigned int i = 0; i < perf.nproc(); ++i) {
+            std::ostringstream s;
+            s << "Perf Counters - Processor " << perf.cpu(i);
+            updater.add(s.str(), boost::bind(&sysmon::PerfCounters::ros_update, &perf, i, _1));
+        }
+    }
+
+    sysmon::Latency latency;
+    for (unsigned int i = 0; i < latency.nprobes(); ++i) {
+        std::ostringstream s;
+        s << "Latency";
+        if (latency.cpu(i) >= 0)
+            s << " - Processor " << latency.cpu(i);
+        updater.add(s.str(), boost::bind(&sysmon::Latency::ros_update, &latency, i, _1));
+    }
+
+    sysmon::Processes processes;
+    updater.add("Processes", &processes, &sysmon::Processes::ros_update);
+
+    sysmon::Watchlist watchlist;
+    std::vector<std::string> watched = watchlist.entries();
+    for (unsigned int i = 0; i < watched.size(); ++i) {
+        std::ostringstream s;
+        s << "Process - " << watched[i];
+        updater.add(s.str(), boost::bind(&sysmon::Watchlist::ros_update, &watchlist, i, _1));
     }
 
-    sysmon::DiskUsage diskusage;
+    double window = 600, warn_horizon = 86400, error_horizon = 3600;
+    ros::param::get("~diskusage/window", window);
+    ros::param::get("~diskusage/warn_horizon", warn_horizon);
+    ros::param::get("~diskusage/error_horizon", error_horizon);
+
+    sysmon::DiskUsage diskusage(files, sysmon::param_list("~diskusage/mountlist"),
+            window, warn_horizon, error_horizon);
     std::vector<std::string> disks = diskusage.disks();
     for (std::vector<std::string>::const_iterator it = disks.begin(); it != disks.end(); ++it) {
         std::ostringstream s;
         s << "Disk Usage - " << (*it);
-        updater.add(s.str(), boost::bind(&sysmon::DiskUsage::ros_update, diskusage, *it, _1));
+        rules.add(updater, s.str(), boost::bind(&sysmon::DiskUsage::ros_update, &diskusage, *it, _1));
+    }
+
+    std::vector<sysmon::Sink *> sinks;
+
+    if (rules.enabled())
+        sinks.push_back(&rules);
+
+    sysmon::Recorder recorder;
+    if (recorder.enabled()) {
+        updater.add("History", &recorder, &sysmon::Recorder::ros_update);
+        sinks.push_back(&recorder);
+    }
+
+    sysmon::SnapshotWriter snapshot;
+    if (snapshot.enabled())
+        sinks.push_back(&snapshot);
+
+    sysmon::Sampler sampler;
+    updater.add("Sampling", &sampler, &sysmon::Sampler::ros_update);
+    if (sampler.adaptive())
+        sinks.push_back(&sampler);
+
+    sysmon::Prometheus prometheus;
+    if (prometheus.enabled()) {
+        updater.add("Prometheus", &prometheus, &sysmon::Prometheus::ros_update);
+        sinks.push_back(&prometheus);
     }
 
     while (nh.ok()) {
-        ros::Duration(1).sleep();
+        ros::Duration(sampler.period()).sleep();
+        files.read();
+
+        /* The diagnostics are published at their own rate, keep the sinks current */
+        cputime.update();
+        loadavg.update();
+        meminfo.update();
+        diskusage.update();
+        power.update();
+
+        for (std::vector<sysmon::Sink *>::const_iterator it = sinks.begin(); it != sinks.end(); ++it) {
+            cputime.record(**it);
+            loadavg.record(**it);
+            meminfo.record(**it);
+            diskusage.record(**it);
+            power.record(**it);
+            (*it)->commit();
+        }
+
         updater.update();
     }
 
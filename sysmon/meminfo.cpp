@@ -28,96 +28,66 @@
  */
 
 #include <cerrno>
+#include <cstring>
 
-#include <iostream>
-#include <fstream>
-#include <list>
-#include <boost/algorithm/string.hpp>
-#include <XmlRpcValue.h>
-
+#include "log.hpp"
 #include "meminfo.hpp"
+#include "parse.hpp"
 
 namespace sysmon {
 
-MemInfo::MemInfo()
-{
-    fill_whitelist();
-}
+MemInfo::MemInfo(FileSet &files, const std::set<std::string> &whitelist) :
+    m_whitelist(whitelist),
+    m_files(&files),
+    m_source(files.add("/proc/meminfo"))
+{}
 
-void MemInfo::ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw)
+void MemInfo::record(Sink &sink) const
 {
-    if (update()) {
-        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Update failed");
-        return;
-    }
+    static const std::string task("Memory");
 
-    dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
     for (meminfoIter it = m_values.begin(); it != m_values.end(); ++it) {
-        if (m_whitelist.size()) {
-            if (std::find(m_whitelist.begin(), m_whitelist.end(), (*it).first) != m_whitelist.end())
-                dsw.add((*it).first, (*it).second);
-        } else {
-            dsw.add((*it).first, (*it).second);
-        }
+        if (m_whitelist.size() && m_whitelist.find((*it).first) == m_whitelist.end())
+            continue;
+        sink.add(task, (*it).first, (*it).second);
     }
 }
 
 int MemInfo::update()
 {
-    std::ifstream fp("/proc/meminfo");
-
-    if (!fp.is_open()) {
-        ROS_ERROR("%s:  Failed to open /proc/meminfo", __func__);
+    const char *data;
+    size_t len;
+    if (m_files->get(m_source, data, len)) {
+        log_error("%s:  Failed to read /proc/meminfo", __func__);
         return EIO;
     }
 
-    std::string line;
-    while (fp.good()) {
-        getline(fp, line);
-
-        std::vector<std::string> res;
-        boost::algorithm::split(res, line, boost::is_any_of(":"));
-
-        if (res.size() < 2)
-            continue;
-
-        std::string value = res.back();
-        boost::trim(value);
-
-        res.pop_back();
-        std::string key = res.back();
-        boost::trim(key);
+    /* MemTotal:        8069876 kB */
+    const char *end = data + len;
+    for (const char *p = data; p < end; ++p) {
+        const char *eol = line_end(p, end);
+        const char *sep = static_cast<const char *>(memchr(p, ':', eol - p));
+
+        if (sep) {
+            const char *key = p;
+            const char *key_end = sep;
+            const char *value = sep + 1;
+            const char *value_end = eol;
+
+            trim(key, key_end);
+            trim(value, value_end);
+
+            m_key.assign(key, key_end - key);
+            meminfo::iterator it = m_values.find(m_key);
+            if (it == m_values.end())
+                it = m_values.insert(std::make_pair(m_key, std::string())).first;
+            (*it).second.assign(value, value_end - value);
+        }
 
-        if (m_values.find(key) != m_values.end())
-            m_values[key] = value;
-        else
-            m_values.insert(std::pair<std::string, std::string>(key, value));
+        p = eol;
     }
 
-    fp.close();
-
     return 0;
 }
 
-void MemInfo::fill_whitelist()
-{
-    if (!ros::param::has("~meminfo/whitelist"))
-        return;
-
-    XmlRpc::XmlRpcValue whitelist;
-    ros::param::get("~meminfo/whitelist", whitelist);
-    if (whitelist.getType() != XmlRpc::XmlRpcValue::TypeArray) {
-        ROS_ERROR("%s:  Invalid value (not TypeArray) for ~meminfo/whitelist", __func__);
-        return;
-    }
-
-    for (int i = 0; i < whitelist.size(); ++i) {
-        if (whitelist[i].getType() != XmlRpc::XmlRpcValue::TypeString)
-            continue;
-
-        m_whitelist.insert(static_cast<std::string>(whitelist[i]));
-    }
-}
-
-
 } // namespace sysmon
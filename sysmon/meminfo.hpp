@@ -29,8 +29,13 @@
 
 #pragma once
 
+#include <map>
+#include <set>
 #include <string>
-#include <diagnostic_updater/diagnostic_updater.h>
+
+#include "diagnostics.hpp"
+#include "fileset.hpp"
+#include "sink.hpp"
 
 namespace sysmon {
 
@@ -38,11 +43,6 @@ class MemInfo {
     /*
      * Parser for /proc/meminfo.  Reads the key value pairs from the file and
      * publishes them via ROS diagnostics.
-     *
-     * ROS Parameters:
-     *
-     * ~/meminfo/whitelist: List of keys from /proc/meminfo that should be
-     *                      published.  This is a list of XmlRpcValue::TypeString.
      */
      public:
         typedef std::map<std::string, std::string> meminfo;
@@ -50,15 +50,13 @@ class MemInfo {
 
         /*
          * Constructor
+         *
+         * @param files     - Set /proc/meminfo is registered with and read from.
+         * @param whitelist - Keys that should be published and recorded,
+         *                    everything if empty (~meminfo/whitelist in sysmon).
          */
-        MemInfo();
-
-        /*
-         * Update the ROS diagnostics.
-         */
-        void ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw);
+        MemInfo(FileSet &files, const std::set<std::string> &whitelist = std::set<std::string>());
 
-    private:
         /*
          * Read the latest value from /proc/meminfo.
          *
@@ -67,14 +65,23 @@ class MemInfo {
         int update();
 
         /*
-         * Query the parameter server for the whitelist of keys that should
-         * be published.
+         * Update the ROS diagnostics (sysmon node only).
          */
-        void fill_whitelist();
+        void ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw);
+
+        /*
+         * Add the values read by the last update to a sink.
+         */
+        void record(Sink &sink) const;
 
+    private:
         meminfo m_values;
+        std::string m_key;
 
         std::set<std::string> m_whitelist;
+
+        FileSet *           m_files;
+        int                 m_source;
 };
 
 } // namespace sysmon
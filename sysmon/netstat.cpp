@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+
+#include "clock.hpp"
+#include "log.hpp"
+#include "netstat.hpp"
+#include "parse.hpp"
+
+namespace sysmon {
+
+namespace {
+
+enum proc_file {
+    SNMP,
+    NETSTAT
+};
+
+struct netstat_key {
+    proc_file           file;
+    const char *        prefix;
+    const char *        name;
+    NetStat::counter    counter;
+};
+
+/*
+ * Counters of interest, by the file, line prefix and header they appear
+ * under.  Each maps to one column of one value line.
+ */
+const netstat_key keys[] = {
+    { SNMP,     "Tcp",      "AttemptFails",     NetStat::TCP_ATTEMPT_FAILS },
+    { SNMP,     "Tcp",      "EstabResets",      NetStat::TCP_ESTAB_RESETS },
+    { SNMP,     "Tcp",      "InErrs",           NetStat::TCP_IN_ERRS },
+    { SNMP,     "Tcp",      "OutRsts",          NetStat::TCP_OUT_RSTS },
+    { SNMP,     "Tcp",      "OutSegs",          NetStat::TCP_OUT_SEGS },
+    { SNMP,     "Tcp",      "RetransSegs",      NetStat::TCP_RETRANS_SEGS },
+    { NETSTAT,  "TcpExt",   "TCPAbortOnMemory", NetStat::TCP_ABORT_ON_MEMORY },
+    { NETSTAT,  "TcpExt",   "TCPBacklogDrop",   NetStat::TCP_BACKLOG_DROP },
+    { NETSTAT,  "TcpExt",   "ListenDrops",      NetStat::TCP_LISTEN_DROPS },
+    { NETSTAT,  "TcpExt",   "ListenOverflows",  NetStat::TCP_LISTEN_OVERFLOWS },
+    { NETSTAT,  "TcpExt",   "TCPSynRetrans",    NetStat::TCP_SYN_RETRANS },
+    { NETSTAT,  "TcpExt",   "TCPTimeouts",      NetStat::TCP_TIMEOUTS },
+    { SNMP,     "Udp",      "InDatagrams",      NetStat::UDP_IN_DATAGRAMS },
+    { SNMP,     "Udp",      "InErrors",         NetStat::UDP_IN_ERRORS },
+    { SNMP,     "Udp",      "NoPorts",          NetStat::UDP_NO_PORTS },
+    { SNMP,     "Udp",      "RcvbufErrors",     NetStat::UDP_RCVBUF_ERRORS },
+    { SNMP,     "Udp",      "SndbufErrors",     NetStat::UDP_SNDBUF_ERRORS },
+};
+
+struct sockstat_key {
+    const char *        prefix;
+    const char *        name;
+    NetStat::gauge      gauge;
+};
+
+const sockstat_key sockstat_keys[] = {
+    { "TCP",    "inuse",    NetStat::TCP_INUSE },
+    { "TCP",    "orphan",   NetStat::TCP_ORPHAN },
+    { "TCP",    "tw",       NetStat::TCP_TW },
+    { "TCP",    "mem",      NetStat::TCP_MEM },
+    { "UDP",    "inuse",    NetStat::UDP_INUSE },
+    { "UDP",    "mem",      NetStat::UDP_MEM },
+};
+
+/*
+ * Compare the len byte string at p with a NUL terminated one.
+ */
+bool equals(const char *p, size_t len, const char *s)
+{
+    return !strncmp(p, s, len) && !s[len];
+}
+
+} // namespace
+
+const char * const NetStat::counter_names[NCOUNTERS] = {
+    "Tcp AttemptFails/s",
+    "Tcp EstabResets/s",
+    "Tcp InErrs/s",
+    "Tcp OutRsts/s",
+    "Tcp OutSegs/s",
+    "Tcp RetransSegs/s",
+    "TcpExt TCPAbortOnMemory/s",
+    "TcpExt TCPBacklogDrop/s",
+    "TcpExt ListenDrops/s",
+    "TcpExt ListenOverflows/s",
+    "TcpExt TCPSynRetrans/s",
+    "TcpExt TCPTimeouts/s",
+    "Udp InDatagrams/s",
+    "Udp InErrors/s",
+    "Udp NoPorts/s",
+    "Udp RcvbufErrors/s",
+    "Udp SndbufErrors/s",
+};
+
+const char * const NetStat::gauge_names[NGAUGES] = {
+    "Tcp sockets",
+    "Tcp orphaned sockets",
+    "Tcp time wait sockets",
+    "Tcp memory (pages)",
+    "Udp sockets",
+    "Udp memory (pages)",
+};
+
+NetStat::NetStat(FileSet &files, double retrans_warn, double drops_warn) :
+    m_retrans(0),
+    m_last(0),
+    m_retrans_warn(retrans_warn),
+    m_drops_warn(drops_warn),
+    m_files(&files),
+    m_last_cycle(-1),
+    m_snmp(files.add("/proc/net/snmp")),
+    m_netstat(files.add("/proc/net/netstat")),
+    m_sockstat(files.add("/proc/net/sockstat"))
+{
+    memset(m_values, 0, sizeof(m_values));
+    memset(m_last_values, 0, sizeof(m_last_values));
+    memset(m_rates, 0, sizeof(m_rates));
+    memset(m_gauges, 0, sizeof(m_gauges));
+
+    resolve(m_snmp, SNMP, m_snmp_columns);
+    resolve(m_netstat, NETSTAT, m_netstat_columns);
+}
+
+void NetStat::record(Sink &sink) const
+{
+    static const std::string task("Network Protocols");
+    static const std::string retrans_key("Tcp retransmits (%)");
+    static const std::vector<std::string> counter_keys(counter_names, counter_names + NCOUNTERS);
+    static const std::vector<std::string> gauge_keys(gauge_names, gauge_names + NGAUGES);
+
+    sink.add(task, retrans_key, m_retrans);
+    for (unsigned int i = 0; i < NCOUNTERS; ++i)
+        sink.add(task, counter_keys[i], m_rates[i]);
+    for (unsigned int i = 0; i < NGAUGES; ++i)
+        sink.add(task, gauge_keys[i], m_gauges[i]);
+}
+
+int NetStat::resolve(int source, int file, std::vector<column> &columns)
+{
+    const char *data;
+    size_t len;
+    if (m_files->get(source, data, len)) {
+        log_error("%s:  Failed to read %s", __func__,
+                file == SNMP ? "/proc/net/snmp" : "/proc/net/netstat");
+        return EIO;
+    }
+
+    /* Every even line is a header, the odd one after it holds its values */
+    const char *end = data + len;
+    unsigned int line = 0;
+    for (const char *p = data; p < end; ++p, ++line) {
+        const char *eol = line_end(p, end);
+        const char *q = p, *word;
+
+        p = eol;
+        if (line % 2 || !next_word(q, eol, word) || q[-1] != ':')
+            continue;
+
+        size_t prefix_len = q - word - 1;
+        const char *prefix = word;
+        for (unsigned int index = 0; next_word(q, eol, word); ++index) {
+            for (unsigned int i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+                if (keys[i].file != file
+                        || !equals(prefix, prefix_len, keys[i].prefix)
+                        || !equals(word, q - word, keys[i].name))
+                    continue;
+
+                column c = { keys[i].prefix, index, keys[i].counter };
+                columns.push_back(c);
+            }
+        }
+    }
+
+    std::sort(columns.begin(), columns.end());
+    return 0;
+}
+
+int NetStat::parse(int source, const std::vector<column> &columns)
+{
+    const char *data;
+    size_t len;
+    if (m_files->get(source, data, len))
+        return EIO;
+
+    /* Every odd line holds the values of the header before it */
+    const char *end = data + len;
+    unsigned int line = 0;
+    for (const char *p = data; p < end; ++p, ++line) {
+        const char *eol = line_end(p, end);
+        const char *q = p, *word;
+
+        p = eol;
+        if (!(line % 2) || !next_word(q, eol, word) || q[-1] != ':')
+            continue;
+
+        size_t prefix_len = q - word - 1;
+        std::vector<column>::const_iterator c = columns.begin();
+        while (c != columns.end() && !equals(word, prefix_len, (*c).prefix))
+            ++c;
+        if (c == columns.end())
+            continue;
+
+        /* Tcp: 1 200 120000 -1 307 ... */
+        const char *prefix = (*c).prefix;
+        for (unsigned int index = 0; c != columns.end() && !strcmp((*c).prefix, prefix); ++index) {
+            if (!next_word(q, eol, word))
+                return EINVAL;
+            if ((*c).index == index) {
+                m_values[(*c).id] = strtoull(word, NULL, 10);
+                ++c;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int NetStat::parse_sockstat()
+{
+    const char *data;
+    size_t len;
+    if (m_files->get(m_sockstat, data, len))
+        return EIO;
+
+    /* TCP: inuse 4 orphan 0 tw 0 alloc 4 mem 0 */
+    const char *end = data + len;
+    for (const char *p = data; p < end; ++p) {
+        const char *eol = line_end(p, end);
+        const char *q = p, *prefix, *name, *value;
+
+        p = eol;
+        if (!next_word(q, eol, prefix) || q[-1] != ':')
+            continue;
+
+        size_t prefix_len = q - prefix - 1;
+        while (next_word(q, eol, name)) {
+            size_t name_len = q - name;
+            if (!next_word(q, eol, value))
+                break;
+
+            for (unsigned int i = 0; i < sizeof(sockstat_keys) / sizeof(sockstat_keys[0]); ++i) {
+                if (equals(prefix, prefix_len, sockstat_keys[i].prefix)
+                        && equals(name, name_len, sockstat_keys[i].name))
+                    m_gauges[sockstat_keys[i].gauge] = strtoull(value, NULL, 10);
+            }
+        }
+    }
+
+    return 0;
+}
+
+int NetStat::update()
+{
+    /* Only the first update of a cycle sees new counters */
+    if (m_files->cycle() == m_last_cycle)
+        return 0;
+
+    if (parse(m_snmp, m_snmp_columns)
+            || parse(m_netstat, m_netstat_columns)
+            || parse_sockstat()) {
+        log_error("%s:  Failed to parse /proc/net", __func__);
+        return EIO;
+    }
+    m_last_cycle = m_files->cycle();
+
+    double now = monotonic_seconds();
+    double dt = now - m_last;
+
+    for (unsigned int i = 0; i < NCOUNTERS; ++i) {
+        if (m_last > 0 && dt > 0 && m_values[i] >= m_last_values[i])
+            m_rates[i] = (m_values[i] - m_last_values[i]) / dt;
+        else
+            m_rates[i] = 0;
+
+        m_last_values[i] = m_values[i];
+    }
+    m_last = now;
+
+    m_retrans = 0;
+    if (m_rates[TCP_OUT_SEGS] > 0)
+        m_retrans = 100 * m_rates[TCP_RETRANS_SEGS] / m_rates[TCP_OUT_SEGS];
+
+    return 0;
+}
+
+} // namespace sysmon
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "diagnostics.hpp"
+#include "fileset.hpp"
+#include "sink.hpp"
+
+namespace sysmon {
+
+class NetStat {
+    /*
+     * Parser for the TCP and UDP counters of /proc/net/snmp and
+     * /proc/net/netstat and the socket gauges of /proc/net/sockstat.
+     *
+     * The first two are header and value line pairs:
+     *
+     *     Tcp: RtoAlgorithm RtoMin RtoMax MaxConn ActiveOpens ...
+     *     Tcp: 1 200 120000 -1 307 ...
+     *
+     * The columns differ between kernels, so the column of each counter of
+     * interest is looked up once by name in the constructor and every update
+     * only picks those columns.  Value lines are found by their prefix on
+     * every update, pairs such as IcmpMsg only appear once the kernel has
+     * counted something for them and move the lines after them.  The counters
+     * are published via ROS diagnostics as per second rates.
+     */
+    public:
+        enum counter {
+            TCP_ATTEMPT_FAILS,
+            TCP_ESTAB_RESETS,
+            TCP_IN_ERRS,
+            TCP_OUT_RSTS,
+            TCP_OUT_SEGS,
+            TCP_RETRANS_SEGS,
+            TCP_ABORT_ON_MEMORY,
+            TCP_BACKLOG_DROP,
+            TCP_LISTEN_DROPS,
+            TCP_LISTEN_OVERFLOWS,
+            TCP_SYN_RETRANS,
+            TCP_TIMEOUTS,
+            UDP_IN_DATAGRAMS,
+            UDP_IN_ERRORS,
+            UDP_NO_PORTS,
+            UDP_RCVBUF_ERRORS,
+            UDP_SNDBUF_ERRORS,
+            NCOUNTERS
+        };
+
+        enum gauge {
+            TCP_INUSE,
+            TCP_ORPHAN,
+            TCP_TW,
+            TCP_MEM,
+            UDP_INUSE,
+            UDP_MEM,
+            NGAUGES
+        };
+
+        /*
+         * Constructor
+         *
+         * @param files         - Set the files are registered with and read
+         *                        from.
+         * @param retrans_warn  - Percentage of TCP segments sent that are
+         *                        retransmits above which the status is raised
+         *                        to WARN (~net/retrans_warn in sysmon).
+         * @param drops_warn    - Listen queue overflows or UDP receive buffer
+         *                        drops per second above which the status is
+         *                        raised to WARN (~net/drops_warn in sysmon).
+         */
+        NetStat(FileSet &files, double retrans_warn = 5, double drops_warn = 1);
+
+        /*
+         * Read the latest values from the files and compute rates.  Only the
+         * first update after each FileSet::read() parses them.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int update();
+
+        /*
+         * Update the ROS diagnostics (sysmon node only).
+         */
+        void ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw);
+
+        /*
+         * Add the values computed by the last update to a sink.
+         */
+        void record(Sink &sink) const;
+
+    private:
+        struct column {
+            const char *    prefix;
+            unsigned int    index;
+            counter         id;
+
+            bool operator<(const column &other) const
+            {
+                int r = strcmp(prefix, other.prefix);
+                return r < 0 || (r == 0 && index < other.index);
+            }
+        };
+
+        /*
+         * Find the line prefix and column of each counter in the header lines
+         * of a /proc/net/snmp style file.
+         *
+         * @param source    - Id of the file in m_files.
+         * @param file      - Which of the files it is, selects the counters.
+         * @param columns   - Filled with the columns, sorted by prefix.
+         * @return          - 0 on success, appropriate errno otherwise.
+         */
+        int resolve(int source, int file, std::vector<column> &columns);
+
+        /*
+         * Pick the resolved columns out of the value lines with their prefix.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int parse(int source, const std::vector<column> &columns);
+
+        /*
+         * Parse the "TCP: inuse 4 orphan 0 ..." lines of /proc/net/sockstat.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int parse_sockstat();
+
+        static const char * const counter_names[NCOUNTERS];
+        static const char * const gauge_names[NGAUGES];
+
+        std::vector<column> m_snmp_columns;
+        std::vector<column> m_netstat_columns;
+
+        unsigned long long  m_values[NCOUNTERS];
+        unsigned long long  m_last_values[NCOUNTERS];
+        double              m_rates[NCOUNTERS];
+        unsigned long long  m_gauges[NGAUGES];
+        double              m_retrans;
+        double              m_last;
+
+        double              m_retrans_warn;
+        double              m_drops_warn;
+
+        FileSet *           m_files;
+        unsigned long       m_last_cycle;
+        int                 m_snmp;
+        int                 m_netstat;
+        int                 m_sockstat;
+};
+
+} // namespace sysmon
@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "clock.hpp"
+#include "numa.hpp"
+#include "parse.hpp"
+#include "status.hpp"
+
+namespace sysmon {
+
+namespace {
+
+const char * numastat_names[] = { "numa_hit", "numa_miss", "numa_foreign" };
+const char * numastat_keys[] = { "numa_hit/s", "numa_miss/s", "numa_foreign/s" };
+
+std::string node_path(unsigned int id, const char *file)
+{
+    std::ostringstream s;
+    s << "/sys/devices/system/node/node" << id << "/" << file;
+    return s.str();
+}
+
+} // namespace
+
+Numa::Numa(FileSet &files) :
+    m_files(&files),
+    m_buddyinfo_source(files.add("/proc/buddyinfo")),
+    m_fragmentation_order(3)
+{
+    int order;
+    if (ros::param::get("~numa/fragmentation_order", order) && order >= 0)
+        m_fragmentation_order = order;
+
+    fill_nodes();
+}
+
+std::vector<unsigned int> Numa::nodes() const
+{
+    std::vector<unsigned int> ret;
+    for (std::vector<node>::const_iterator it = m_nodes.begin(); it != m_nodes.end(); ++it)
+        ret.push_back((*it).id);
+    return ret;
+}
+
+void Numa::ros_update(unsigned int id, diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+
+    std::vector<node>::iterator n;
+    for (n = m_nodes.begin(); n != m_nodes.end(); ++n) {
+        if ((*n).id == id)
+            break;
+    }
+
+    if (n == m_nodes.end()) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Unknown node id");
+        return;
+    }
+
+    if (update(*n)) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Update failed");
+        return;
+    }
+
+    dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+
+    values.add("MemTotal", (*n).mem_total);
+    values.add("MemFree", (*n).mem_free);
+    if ((*n).mem_total)
+        values.add("free %", 100.0 * (*n).mem_free / (*n).mem_total);
+
+    for (unsigned int i = 0; i < NNUMASTAT; ++i)
+        values.add(numastat_keys[i], (*n).rates[i]);
+
+    values.add("fragmentation index", (*n).fragmentation);
+}
+
+void Numa::fill_nodes()
+{
+    DIR *dir = opendir("/sys/devices/system/node");
+    if (!dir)
+        return;
+
+    std::vector<unsigned int> ids;
+    struct dirent *ent;
+    while ((ent = readdir(dir))) {
+        if (strncmp(ent->d_name, "node", 4) || !isdigit(ent->d_name[4]))
+            continue;
+
+        ids.push_back(strtoul(ent->d_name + 4, NULL, 10));
+    }
+    closedir(dir);
+
+    std::sort(ids.begin(), ids.end());
+    for (std::vector<unsigned int>::const_iterator it = ids.begin(); it != ids.end(); ++it) {
+        node n;
+        memset(&n, 0, sizeof(n));
+        n.id = *it;
+        n.meminfo_source = m_files->add(node_path(n.id, "meminfo"));
+        n.numastat_source = m_files->add(node_path(n.id, "numastat"));
+        m_nodes.push_back(n);
+    }
+}
+
+int Numa::update(node &n)
+{
+    int r;
+
+    if ((r = read_meminfo(n)))
+        return r;
+
+    if ((r = read_numastat(n)))
+        return r;
+
+    return read_buddyinfo(n);
+}
+
+int Numa::read_meminfo(node &n)
+{
+    const char *data;
+    size_t len;
+    if (m_files->get(n.meminfo_source, data, len)) {
+        ROS_ERROR("%s:  Failed to read %s", __func__, m_files->path(n.meminfo_source).c_str());
+        return EIO;
+    }
+
+    /* Node 0 MemFree:         3496344 kB */
+    const char *end = data + len;
+    for (const char *p = data; p < end; ++p) {
+        const char *eol = line_end(p, end);
+        const char *line = p;
+        const char *tag, *id, *key;
+
+        p = eol;
+
+        if (!next_word(line, eol, tag) || !next_word(line, eol, id) || !next_word(line, eol, key))
+            continue;
+
+        if (!strncmp(key, "MemTotal:", line - key))
+            n.mem_total = strtoull(line, NULL, 10);
+        else if (!strncmp(key, "MemFree:", line - key))
+            n.mem_free = strtoull(line, NULL, 10);
+    }
+
+    return 0;
+}
+
+int Numa::read_numastat(node &n)
+{
+    const char *data;
+    size_t len;
+    if (m_files->get(n.numastat_source, data, len)) {
+        ROS_ERROR("%s:  Failed to read %s", __func__, m_files->path(n.numastat_source).c_str());
+        return EIO;
+    }
+
+    unsigned long long values[NNUMASTAT];
+    memcpy(values, n.numastat, sizeof(values));
+
+    /* numa_hit 123456 */
+    const char *end = data + len;
+    for (const char *p = data; p < end; ++p) {
+        const char *eol = line_end(p, end);
+        const char *line = p;
+        const char *key;
+
+        p = eol;
+
+        if (!next_word(line, eol, key))
+            continue;
+
+        for (unsigned int i = 0; i < NNUMASTAT; ++i) {
+            if ((size_t)(line - key) == strlen(numastat_names[i])
+                    && !strncmp(key, numastat_names[i], line - key))
+                values[i] = strtoull(line, NULL, 10);
+        }
+    }
+
+    double now = monotonic_seconds();
+    double dt = now - n.last;
+
+    for (unsigned int i = 0; i < NNUMASTAT; ++i) {
+        if (n.last > 0 && dt > 0 && values[i] >= n.numastat[i])
+            n.rates[i] = (values[i] - n.numastat[i]) / dt;
+        else
+            n.rates[i] = 0;
+
+        n.numastat[i] = values[i];
+    }
+    n.last = now;
+
+    return 0;
+}
+
+int Numa::read_buddyinfo(node &n)
+{
+    const char *data;
+    size_t len;
+    if (m_files->get(m_buddyinfo_source, data, len)) {
+        ROS_ERROR("%s:  Failed to read /proc/buddyinfo", __func__);
+        return EIO;
+    }
+
+    /* Free page counts for each order summed across the zones of the node */
+    unsigned long long pages[MAX_ORDERS];
+    unsigned int norders = 0;
+
+    /* Node 0, zone   Normal   3795   3042   2226 ... */
+    const char *end = data + len;
+    for (const char *p = data; p < end; ++p) {
+        const char *eol = line_end(p, end);
+        const char *line = p;
+        const char *tag, *id, *zonetag, *zone, *count;
+
+        p = eol;
+
+        if (!next_word(line, eol, tag) || !next_word(line, eol, id)
+                || strtoul(id, NULL, 10) != n.id
+                || !next_word(line, eol, zonetag) || !next_word(line, eol, zone))
+            continue;
+
+        for (unsigned int order = 0; order < MAX_ORDERS && next_word(line, eol, count); ++order) {
+            if (order >= norders)
+                pages[norders++] = 0;
+            pages[order] += strtoull(count, NULL, 10) << order;
+        }
+    }
+
+    unsigned long long total = 0;
+    unsigned long long usable = 0;
+    for (unsigned int order = 0; order < norders; ++order) {
+        total += pages[order];
+        if (order >= m_fragmentation_order)
+            usable += pages[order];
+    }
+
+    n.fragmentation = total ? (double)(total - usable) / total : 0;
+
+    return 0;
+}
+
+} // namespace sysmon
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <diagnostic_updater/diagnostic_updater.h>
+
+#include "fileset.hpp"
+
+namespace sysmon {
+
+class Numa {
+    /*
+     * Monitors the memory of each NUMA node and publishes via ROS
+     * diagnostics.  Free memory is read from
+     * /sys/devices/system/node/nodeN/meminfo, allocation placement from
+     * nodeN/numastat and free block sizes from /proc/buddyinfo.
+     *
+     * The fragmentation index is the fraction of free memory held in blocks
+     * too small to satisfy an allocation of the configured order.  0 means
+     * every free page could be used, values approaching 1 mean high order
+     * allocations will have to wait for compaction or reclaim.
+     *
+     * ROS Parameters:
+     *
+     * ~/numa/fragmentation_order:  Allocation order the fragmentation index
+     *                              is computed for.  Default 3.
+     */
+    public:
+        /*
+         * Constructor
+         *
+         * @param files - Set the node files are registered with and read from.
+         */
+        Numa(FileSet &files);
+
+        /*
+         * Return list of nodes that are being monitored.
+         */
+        std::vector<unsigned int> nodes() const;
+
+        /*
+         * Update the ROS diagnostics.
+         *
+         * @param node  - node to publish statistics for.
+         */
+        void ros_update(unsigned int node, diagnostic_updater::DiagnosticStatusWrapper &dsw);
+
+    private:
+        enum numastat {
+            NUMA_HIT,
+            NUMA_MISS,
+            NUMA_FOREIGN,
+            NNUMASTAT
+        };
+
+        /*
+         * Upper bound on the page orders listed in /proc/buddyinfo
+         * (MAX_ORDER is 11 on most configurations).
+         */
+        enum { MAX_ORDERS = 32 };
+
+        struct node {
+            unsigned int        id;
+            int                 meminfo_source;
+            int                 numastat_source;
+
+            unsigned long long  mem_total;
+            unsigned long long  mem_free;
+
+            unsigned long long  numastat[NNUMASTAT];
+            double              rates[NNUMASTAT];
+            double              last;
+
+            double              fragmentation;
+        };
+
+        /*
+         * Find the nodes listed under /sys/devices/system/node.
+         */
+        void fill_nodes();
+
+        /*
+         * Read the latest values for a node.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int update(node &n);
+
+        int read_meminfo(node &n);
+        int read_numastat(node &n);
+        int read_buddyinfo(node &n);
+
+        std::vector<node>   m_nodes;
+
+        FileSet *           m_files;
+        int                 m_buddyinfo_source;
+
+        unsigned int        m_fragmentation_order;
+};
+
+} // namespace sysmon
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace sysmon {
+
+/*
+ * Helpers for parsing the buffers read by FileSet in place.  None of them
+ * allocate, a collector that assigns into strings it already holds does not
+ * touch the heap once its first update has sized everything.
+ */
+
+/*
+ * Find the end of the line starting at p.
+ *
+ * @return  - Pointer to the newline, end if the line is not terminated.
+ */
+inline const char * line_end(const char *p, const char *end)
+{
+    const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+    return eol ? eol : end;
+}
+
+/*
+ * Skip leading and trailing blanks of the range [begin, end).
+ */
+inline void trim(const char *&begin, const char *&end)
+{
+    while (begin < end && (*begin == ' ' || *begin == '\t'))
+        ++begin;
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n'))
+        --end;
+}
+
+/*
+ * Find the next blank separated word in [p, end).
+ *
+ * @return  - true if a word was found, it is returned in [word, p).
+ */
+inline bool next_word(const char *&p, const char *end, const char *&word)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+    word = p;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\n')
+        ++p;
+    return p != word;
+}
+
+/*
+ * printf into an existing string, reusing its storage.
+ */
+inline void assign_format(std::string &dest, const char *fmt, ...)
+{
+    char buf[64];
+    va_list ap;
+
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    if (n < 0)
+        n = 0;
+    else if (n >= (int)sizeof(buf))
+        n = sizeof(buf) - 1;
+    dest.assign(buf, n);
+}
+
+} // namespace sysmon
@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <ros/ros.h>
+
+#include "clock.hpp"
+#include "perf.hpp"
+#include "status.hpp"
+
+namespace sysmon {
+
+namespace {
+
+struct counter {
+    uint32_t            type;
+    uint64_t            config;
+};
+
+const counter hardware_counters[] = {
+    { PERF_TYPE_HARDWARE,   PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE,   PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE,   PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_TYPE_HARDWARE,   PERF_COUNT_HW_BRANCH_MISSES },
+};
+
+/*
+ * Counted system wide the task clock includes the idle task and always reads
+ * the elapsed time, so it is left out.
+ */
+const counter software_counters[] = {
+    { PERF_TYPE_SOFTWARE,   PERF_COUNT_SW_CONTEXT_SWITCHES },
+    { PERF_TYPE_SOFTWARE,   PERF_COUNT_SW_CPU_MIGRATIONS },
+    { PERF_TYPE_SOFTWARE,   PERF_COUNT_SW_PAGE_FAULTS },
+    { PERF_TYPE_SOFTWARE,   PERF_COUNT_SW_PAGE_FAULTS_MAJ },
+};
+
+/*
+ * Layout of a PERF_FORMAT_GROUP read with both times.
+ */
+struct group_read {
+    uint64_t            nr;
+    uint64_t            enabled;
+    uint64_t            running;
+    uint64_t            values[4];        /* one per counter */
+};
+
+int perf_event_open(struct perf_event_attr *attr, int cpu, int group_fd)
+{
+    return syscall(__NR_perf_event_open, attr, -1, cpu, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+} // namespace
+
+PerfCounters::PerfCounters() :
+    m_enabled(false),
+    m_hardware(true),
+    m_err(0),
+    m_last(0),
+    m_dt(0)
+{
+    memset(m_totals, 0, sizeof(m_totals));
+
+    ros::param::get("~perf/enabled", m_enabled);
+    if (!m_enabled)
+        return;
+
+    int r = open_groups(true);
+    if (!r)
+        return;
+
+    ROS_WARN("%s:  Hardware counters unavailable (errno %d), using software counters", __func__, r);
+    m_hardware = false;
+
+    if ((r = open_groups(false))) {
+        ROS_ERROR("%s:  Failed to open software counters, errno %d", __func__, r);
+        m_err = r;
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    close_groups();
+}
+
+bool PerfCounters::enabled() const
+{
+    return m_enabled;
+}
+
+unsigned int PerfCounters::nproc() const
+{
+    return m_groups.size();
+}
+
+unsigned int PerfCounters::cpu(unsigned int index) const
+{
+    if (index >= m_groups.size())
+        return index;
+    return m_groups[index].cpu;
+}
+
+void PerfCounters::ros_update(int proc, diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+
+    if (m_groups.empty()) {
+        std::string reason = "Unsupported";
+        if (m_err)
+            reason = reason + ", " + strerror(m_err);
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, reason);
+        return;
+    }
+
+    if (proc < -1 || proc >= (int)m_groups.size()) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Unknown processor id");
+        return;
+    }
+
+    if (proc == -1 && update()) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Update failed");
+        return;
+    }
+
+    dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+
+    if (proc == -1) {
+        values.add("counters", m_hardware ? "hardware" : "software");
+        publish(m_totals, values);
+    } else {
+        publish(m_groups[proc].deltas, values);
+    }
+}
+
+int PerfCounters::open_groups(bool hardware)
+{
+    const counter *counters = hardware ? hardware_counters : software_counters;
+    long ncpus = sysconf(_SC_NPROCESSORS_CONF);
+
+    for (long cpu = 0; cpu < ncpus; ++cpu) {
+        group g;
+        memset(&g, 0, sizeof(g));
+        g.cpu = cpu;
+
+        int r = 0;
+        for (unsigned int i = 0; i < NCOUNTERS; ++i) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = counters[i].type;
+            attr.config = counters[i].config;
+            attr.read_format = PERF_FORMAT_GROUP
+                | PERF_FORMAT_TOTAL_TIME_ENABLED
+                | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            attr.disabled = i == 0;
+            attr.exclude_hv = 1;
+
+            g.fds[i] = perf_event_open(&attr, cpu, i ? g.fds[0] : -1);
+            if (g.fds[i] < 0) {
+                r = errno;
+                break;
+            }
+        }
+
+        if (r) {
+            for (unsigned int i = 0; i < NCOUNTERS && g.fds[i] >= 0; ++i)
+                close(g.fds[i]);
+
+            /* Offline cpu */
+            if (r == ENODEV)
+                continue;
+
+            close_groups();
+            return r;
+        }
+
+        m_groups.push_back(g);
+    }
+
+    if (m_groups.empty())
+        return ENODEV;
+
+    for (std::vector<group>::const_iterator it = m_groups.begin(); it != m_groups.end(); ++it)
+        ioctl((*it).fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+    return 0;
+}
+
+void PerfCounters::close_groups()
+{
+    for (std::vector<group>::const_iterator it = m_groups.begin(); it != m_groups.end(); ++it) {
+        for (unsigned int i = 0; i < NCOUNTERS; ++i)
+            close((*it).fds[i]);
+    }
+    m_groups.clear();
+}
+
+int PerfCounters::update()
+{
+    double now = monotonic_seconds();
+    m_dt = m_last > 0 ? now - m_last : 0;
+    m_last = now;
+
+    memset(m_totals, 0, sizeof(m_totals));
+
+    for (std::vector<group>::iterator it = m_groups.begin(); it != m_groups.end(); ++it) {
+        group_read buf;
+
+        ssize_t n = read((*it).fds[0], &buf, sizeof(buf));
+        if (n != (ssize_t)sizeof(buf) || buf.nr != NCOUNTERS) {
+            ROS_ERROR("%s:  Failed to read the counters of cpu %u, errno %d", __func__, (*it).cpu, n < 0 ? errno : EIO);
+            return EIO;
+        }
+
+        /* Scale up what was counted while the counters were multiplexed */
+        uint64_t enabled = buf.enabled - (*it).enabled;
+        uint64_t running = buf.running - (*it).running;
+        double scale = running ? (double)enabled / running : 0;
+
+        /* The first read counts from when the counters were opened, not a period */
+        if (m_dt <= 0)
+            scale = 0;
+
+        for (unsigned int i = 0; i < NCOUNTERS; ++i) {
+            (*it).deltas[i] = (buf.values[i] - (*it).values[i]) * scale;
+            (*it).values[i] = buf.values[i];
+            m_totals[i] += (*it).deltas[i];
+        }
+        (*it).enabled = buf.enabled;
+        (*it).running = buf.running;
+    }
+
+    return 0;
+}
+
+void PerfCounters::publish(const double *deltas, StatusValues &values) const
+{
+    double dt = m_dt > 0 ? m_dt : 1;
+
+    if (m_hardware) {
+        double cycles = deltas[0];
+        double instructions = deltas[1];
+
+        values.add("IPC", cycles ? instructions / cycles : 0);
+        values.add("cache misses/kinstr", instructions ? 1000 * deltas[2] / instructions : 0);
+        values.add("branch misses/kinstr", instructions ? 1000 * deltas[3] / instructions : 0);
+        values.add("cycles/s", cycles / dt);
+        values.add("instructions/s", instructions / dt);
+    } else {
+        values.add("context switches/s", deltas[0] / dt);
+        values.add("migrations/s", deltas[1] / dt);
+        values.add("page faults/s", deltas[2] / dt);
+        values.add("major faults/s", deltas[3] / dt);
+    }
+}
+
+} // namespace sysmon
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <diagnostic_updater/diagnostic_updater.h>
+
+namespace sysmon {
+
+class StatusValues;
+
+class PerfCounters {
+    /*
+     * Samples the hardware performance counters of every cpu through
+     * perf_event_open(2) to tell a busy cpu doing useful work from one
+     * stalling on memory.  Cycles, instructions, cache misses and branch
+     * misses are opened as one group per cpu at startup, each update reads
+     * a group with a single read().  Instructions per cycle and misses per
+     * thousand instructions are published per cpu and in total.
+     *
+     * Where the hardware counters are unavailable, as in most virtual
+     * machines, the software context switch, migration and page fault
+     * counters are used instead.  Counting system wide needs
+     * CAP_PERFMON (or CAP_SYS_ADMIN) or kernel.perf_event_paranoid <= 0.
+     *
+     * ROS Parameters:
+     *
+     * ~/perf/enabled:  Open the counters.  Default false, profilers running
+     *                  on the host share the same hardware counters.
+     */
+    public:
+        /*
+         * Constructor
+         */
+        PerfCounters();
+
+        ~PerfCounters();
+
+        /*
+         * Whether counting was asked for with ~perf/enabled.
+         */
+        bool enabled() const;
+
+        /*
+         * Get the number of cpus counted.
+         */
+        unsigned int nproc() const;
+
+        /*
+         * Get the processor id of a counted cpu.
+         *
+         * @param index - Value from 0 to nproc() - 1.
+         */
+        unsigned int cpu(unsigned int index) const;
+
+        /*
+         * Update the ROS diagnostics.
+         *
+         * @param proc  - Index from -1 to nproc() - 1.  -1 represents the
+         *              total across all cpus and reads the counters, the per
+         *              processor tasks publish that same sample so must be
+         *              registered after it.
+         */
+        void ros_update(int proc, diagnostic_updater::DiagnosticStatusWrapper &dsw);
+
+    private:
+        enum {
+            NCOUNTERS = 4
+        };
+
+        struct group {
+            unsigned int        cpu;
+            int                 fds[NCOUNTERS];
+            uint64_t            values[NCOUNTERS];
+            uint64_t            enabled;
+            uint64_t            running;
+            double              deltas[NCOUNTERS];
+        };
+
+        /*
+         * Open a group of counters on every cpu.
+         *
+         * @param hardware  - Open the hardware rather than the software set.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int open_groups(bool hardware);
+
+        void close_groups();
+
+        /*
+         * Read every group and compute the change since the last read,
+         * scaled up when the counters were multiplexed.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int update();
+
+        /*
+         * Add the counters of a cpu, or of the total, to the diagnostics.
+         */
+        void publish(const double *deltas, StatusValues &values) const;
+
+        PerfCounters(const PerfCounters &);
+        PerfCounters & operator=(const PerfCounters &);
+
+        std::vector<group>  m_groups;
+        bool                m_enabled;
+        bool                m_hardware;
+        int                 m_err;
+
+        double              m_totals[NCOUNTERS];
+        double              m_last;
+        double              m_dt;
+};
+
+} // namespace sysmon
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+
+#include "clock.hpp"
+#include "log.hpp"
+#include "power.hpp"
+
+namespace sysmon {
+
+namespace {
+
+/*
+ * Read a sysfs attribute, without the trailing newline.
+ */
+bool read_attr(const std::string &path, std::string &value)
+{
+    char buf[256];
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    ssize_t n = read(fd, buf, sizeof(buf));
+    close(fd);
+    if (n <= 0)
+        return false;
+
+    while (n > 0 && buf[n - 1] == '\n')
+        --n;
+    value.assign(buf, n);
+    return true;
+}
+
+} // namespace
+
+Power::Power(FileSet &files, const std::string &root) :
+    m_err(ENOENT),
+    m_last(0),
+    m_last_cycle(-1),
+    m_files(&files)
+{
+    std::string base = files.root() + root;
+    DIR *dir = opendir(base.c_str());
+    if (!dir)
+        return;
+
+    /*
+     * Zones are named <control type>:<package>[:<domain>].  intel-rapl-mmio
+     * exposes the same packages as intel-rapl and is skipped.
+     */
+    std::vector<std::string> dirs;
+    struct dirent *ent;
+    while ((ent = readdir(dir))) {
+        if (strchr(ent->d_name, ':') && !strstr(ent->d_name, "-mmio:"))
+            dirs.push_back(ent->d_name);
+    }
+    closedir(dir);
+
+    std::sort(dirs.begin(), dirs.end());
+
+    std::map<std::string, std::string> names;
+    for (std::vector<std::string>::const_iterator it = dirs.begin(); it != dirs.end(); ++it) {
+        std::string path = root + "/" + *it;
+        std::string name, range;
+
+        if (!read_attr(files.root() + path + "/name", name)
+                || !read_attr(files.root() + path + "/max_energy_range_uj", range))
+            continue;
+
+        /* Sorting puts a package before its domains */
+        std::map<std::string, std::string>::const_iterator parent = names.find((*it).substr(0, (*it).rfind(':')));
+        if (parent != names.end())
+            name = (*parent).second + "/" + name;
+        names[*it] = name;
+
+        for (unsigned int i = 0; i < m_zones.size(); ++i) {
+            if (m_zones[i].name == name) {
+                name += " (" + *it + ")";
+                break;
+            }
+        }
+
+        std::string energy = path + "/energy_uj";
+        if (access((files.root() + energy).c_str(), R_OK)) {
+            m_err = errno;
+            continue;
+        }
+
+        zone z;
+        z.name = name;
+        z.power_key = name + " (W)";
+        z.energy_key = name + " (J)";
+        z.source = files.add(energy);
+        z.range = strtoull(range.c_str(), NULL, 10);
+        z.last = 0;
+        z.energy = 0;
+        z.power = 0;
+
+        if (z.source < 0) {
+            m_err = -z.source;
+            continue;
+        }
+        m_zones.push_back(z);
+    }
+
+    if (m_zones.size())
+        m_err = 0;
+}
+
+bool Power::supported() const
+{
+    return m_zones.size();
+}
+
+void Power::record(Sink &sink) const
+{
+    static const std::string task("Power");
+
+    for (std::vector<zone>::const_iterator it = m_zones.begin(); it != m_zones.end(); ++it) {
+        sink.add(task, (*it).power_key, (*it).power);
+        sink.add(task, (*it).energy_key, (*it).energy);
+    }
+}
+
+int Power::update()
+{
+    /* Every task updates, only the first update of a cycle sees new counters */
+    if (m_files->cycle() == m_last_cycle)
+        return 0;
+    m_last_cycle = m_files->cycle();
+
+    double now = monotonic_seconds();
+    double dt = now - m_last;
+    int ret = 0;
+
+    for (std::vector<zone>::iterator it = m_zones.begin(); it != m_zones.end(); ++it) {
+        const char *data;
+        size_t len;
+
+        if (m_files->get((*it).source, data, len)) {
+            log_error("%s:  Failed to read %s", __func__, m_files->path((*it).source).c_str());
+            ret = EIO;
+            continue;
+        }
+
+        unsigned long long uj = strtoull(data, NULL, 10);
+
+        if (m_last > 0) {
+            unsigned long long delta;
+            if (uj >= (*it).last)
+                delta = uj - (*it).last;
+            else
+                delta = (*it).range - (*it).last + uj;
+
+            (*it).energy += delta / 1e6;
+            (*it).power = dt > 0 ? delta / 1e6 / dt : 0;
+        }
+        (*it).last = uj;
+    }
+    m_last = now;
+
+    return ret;
+}
+
+} // namespace sysmon
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "diagnostics.hpp"
+#include "fileset.hpp"
+#include "sink.hpp"
+
+namespace sysmon {
+
+class Power {
+    /*
+     * Reads the energy counters of the powercap zones (RAPL on Intel and AMD
+     * cpus) and reports the power drawn by each package and its domains
+     * (core, uncore, dram, ...) since the last update along with the energy
+     * used since sysmon started.  Recorded next to the cpu time this gives
+     * the energy spent per unit of work.
+     *
+     * The energy_uj counters are held open in the FileSet, counters
+     * wrapping around are unwrapped with max_energy_range_uj.  Without
+     * powercap, or without permission to read the counters (root only on
+     * recent kernels), the collector reports itself as unsupported.
+     */
+    public:
+        /*
+         * Constructor
+         *
+         * @param files - Set the energy counters are registered with and read from.
+         * @param root  - Directory to look for zones in, relative to the
+         *                root of files.
+         */
+        Power(FileSet &files, const std::string &root = "/sys/class/powercap");
+
+        /*
+         * Whether any zone could be read.
+         */
+        bool supported() const;
+
+        /*
+         * Read the latest energy counters.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int update();
+
+        /*
+         * Update the ROS diagnostics (sysmon node only).
+         */
+        void ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw);
+
+        /*
+         * Add the values read by the last update to a sink.
+         */
+        void record(Sink &sink) const;
+
+    private:
+        struct zone {
+            std::string         name;
+            std::string         power_key;
+            std::string         energy_key;
+            int                 source;
+            unsigned long long  range;
+            unsigned long long  last;
+            double              energy;
+            double              power;
+        };
+
+        std::vector<zone>   m_zones;
+        int                 m_err;
+
+        double              m_last;
+        unsigned long       m_last_cycle;
+
+        FileSet *           m_files;
+};
+
+} // namespace sysmon
@@ -0,0 +1,410 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "clock.hpp"
+#include "processes.hpp"
+#include "procstat.hpp"
+#include "status.hpp"
+
+namespace sysmon {
+
+namespace {
+
+unsigned long long clock_ns(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Convert a start time from /proc/[pid]/stat, in clock ticks since boot, to
+ * the monotonic clock used by proc connector timestamps.
+ */
+unsigned long long start_to_monotonic(unsigned long long ticks)
+{
+    static const long hz = sysconf(_SC_CLK_TCK);
+    unsigned long long since_boot = ticks * (1000000000ULL / hz);
+    unsigned long long mono = clock_ns(CLOCK_MONOTONIC);
+    unsigned long long boot = clock_ns(CLOCK_BOOTTIME);
+
+    /* Time spent suspended, the clocks are equal on hosts that never slept */
+    unsigned long long suspended = boot > mono ? boot - mono : 0;
+
+    return since_boot > suspended ? since_boot - suspended : 0;
+}
+
+bool by_count(const std::pair<unsigned int, std::string> &a, const std::pair<unsigned int, std::string> &b)
+{
+    return a.first > b.first;
+}
+
+} // namespace
+
+Processes::Processes() :
+    m_running(false),
+    m_sock(-1),
+    m_connector_err(0),
+    m_forks(0),
+    m_execs(0),
+    m_exits(0),
+    m_last(monotonic_seconds()),
+    m_short_lived_threshold(1.0),
+    m_top(5)
+{
+    bool connector = true;
+
+    ros::param::get("~process/connector", connector);
+    ros::param::get("~process/short_lived", m_short_lived_threshold);
+    ros::param::get("~process/top", m_top);
+
+    if (connector) {
+        int r = open_connector();
+        if (r)
+            ROS_WARN("%s:  proc connector unavailable (errno %d), scanning /proc instead", __func__, r);
+    }
+
+    /* Subscribe first so nothing is missed between the scan and the first event */
+    scan(false);
+
+    if (m_sock >= 0) {
+        m_running = true;
+        m_thread = boost::thread(&Processes::listen, this);
+    }
+}
+
+Processes::~Processes()
+{
+    m_running = false;
+    m_thread.join();
+
+    if (m_sock >= 0)
+        close(m_sock);
+}
+
+void Processes::ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+    bool connector;
+
+    {
+        boost::mutex::scoped_lock lock(m_lock);
+        connector = m_sock >= 0;
+    }
+
+    if (!connector && scan(true)) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Update failed");
+        return;
+    }
+
+    boost::mutex::scoped_lock lock(m_lock);
+
+    double now = monotonic_seconds();
+    double dt = now - m_last;
+
+    if (m_connector_err) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::WARN, "proc connector failed, scanning /proc");
+        values.add("connector errno", m_connector_err);
+    } else {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+    }
+
+    values.add("source", m_sock >= 0 ? "proc connector" : "/proc scan");
+    values.add("processes", m_table.size());
+    if (dt > 0) {
+        values.add("forks/s", m_forks / dt);
+        if (m_sock >= 0)
+            values.add("execs/s", m_execs / dt);
+        values.add("exits/s", m_exits / dt);
+    }
+
+    std::vector<std::pair<unsigned int, std::string> > top;
+    for (std::map<std::string, unsigned int>::const_iterator it = m_short_lived.begin();
+            it != m_short_lived.end();
+            ++it) {
+        top.push_back(std::make_pair((*it).second, (*it).first));
+    }
+
+    size_t n = std::min<size_t>(std::max(m_top, 0), top.size());
+    std::partial_sort(top.begin(), top.begin() + n, top.end(), by_count);
+    for (size_t i = 0; i < n; ++i)
+        values.add("short-lived: " + top[i].second, top[i].first);
+
+    m_forks = m_execs = m_exits = 0;
+    m_short_lived.clear();
+    m_last = now;
+}
+
+int Processes::open_connector()
+{
+    m_sock = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (m_sock < 0)
+        return errno;
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = CN_IDX_PROC;
+
+    if (bind(m_sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr))) {
+        int r = errno;
+        close(m_sock);
+        m_sock = -1;
+        return r;
+    }
+
+    union {
+        struct nlmsghdr hdr;
+        char            buf[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))];
+    } req;
+    memset(&req, 0, sizeof(req));
+
+    enum proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+    struct cn_msg *msg = static_cast<struct cn_msg *>(NLMSG_DATA(&req.hdr));
+
+    req.hdr.nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(op));
+    req.hdr.nlmsg_type = NLMSG_DONE;
+    msg->id.idx = CN_IDX_PROC;
+    msg->id.val = CN_VAL_PROC;
+    msg->len = sizeof(op);
+    memcpy(msg->data, &op, sizeof(op));
+
+    if (send(m_sock, &req, req.hdr.nlmsg_len, 0) < 0) {
+        int r = errno;
+        close(m_sock);
+        m_sock = -1;
+        return r;
+    }
+
+    return 0;
+}
+
+void Processes::listen()
+{
+    struct pollfd pfd;
+    pfd.fd = m_sock;
+    pfd.events = POLLIN;
+
+    while (m_running) {
+        /* Wake periodically to notice shutdown */
+        int r = poll(&pfd, 1, 200);
+        if (r <= 0)
+            continue;
+
+        r = drain_connector();
+        if (r) {
+            ROS_ERROR("%s:  Failed to read proc connector, errno %d, scanning /proc instead", __func__, r);
+
+            /* The next update falls back to scan() */
+            boost::mutex::scoped_lock lock(m_lock);
+            close(m_sock);
+            m_sock = -1;
+            m_connector_err = r;
+            return;
+        }
+    }
+}
+
+int Processes::drain_connector()
+{
+    union {
+        struct nlmsghdr hdr;
+        char            buf[16384];
+    } resp;
+
+    for (;;) {
+        ssize_t n = recv(m_sock, &resp, sizeof(resp), MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            if (errno == ENOBUFS) {
+                ROS_WARN("%s:  proc connector events lost, rescanning /proc", __func__);
+                scan(true);
+                continue;
+            }
+            return errno;
+        }
+
+        int len = n;
+        for (struct nlmsghdr *nlh = &resp.hdr; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+            if (nlh->nlmsg_type == NLMSG_NOOP || nlh->nlmsg_type == NLMSG_ERROR)
+                continue;
+
+            struct cn_msg *msg = static_cast<struct cn_msg *>(NLMSG_DATA(nlh));
+            if (msg->id.idx != CN_IDX_PROC || msg->id.val != CN_VAL_PROC)
+                continue;
+
+            struct proc_event *ev = reinterpret_cast<struct proc_event *>(msg->data);
+
+            /* Read the new command's name before taking the lock */
+            pid_stat st;
+            int stat_err = ENOENT;
+            if (ev->what == proc_event::PROC_EVENT_EXEC)
+                stat_err = read_pid_stat(ev->event_data.exec.process_tgid, st);
+
+            boost::mutex::scoped_lock lock(m_lock);
+            switch (ev->what) {
+                case proc_event::PROC_EVENT_FORK: {
+                    /* Threads are not tracked */
+                    if (ev->event_data.fork.child_pid != ev->event_data.fork.child_tgid)
+                        break;
+
+                    /* The child shares its parent's name until it calls exec */
+                    process p;
+                    std::map<int, process>::const_iterator parent = m_table.find(ev->event_data.fork.parent_tgid);
+                    if (parent != m_table.end())
+                        p.comm = (*parent).second.comm;
+                    p.start_ns = ev->timestamp_ns;
+
+                    m_table[ev->event_data.fork.child_tgid] = p;
+                    ++m_forks;
+                    break;
+                }
+
+                case proc_event::PROC_EVENT_EXEC: {
+                    int pid = ev->event_data.exec.process_tgid;
+                    if (ev->event_data.exec.process_pid != pid)
+                        break;
+
+                    /* Short-lived commands may be gone already, keep the parent's name */
+                    if (!stat_err) {
+                        m_table[pid].comm = st.comm;
+                        m_table[pid].start_ns = start_to_monotonic(st.starttime);
+                    }
+                    ++m_execs;
+                    break;
+                }
+
+                case proc_event::PROC_EVENT_EXIT: {
+                    if (ev->event_data.exit.process_pid != ev->event_data.exit.process_tgid)
+                        break;
+
+                    remove(ev->event_data.exit.process_tgid, ev->timestamp_ns);
+                    ++m_exits;
+                    break;
+                }
+
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+int Processes::scan(bool count)
+{
+    DIR *dir = opendir("/proc");
+    if (!dir) {
+        int r = errno;
+        ROS_ERROR("%s:  Failed to open /proc, errno %d", __func__, r);
+        return r;
+    }
+
+    boost::mutex::scoped_lock lock(m_lock);
+
+    std::set<int> seen;
+    struct dirent *ent;
+    while ((ent = readdir(dir))) {
+        if (!isdigit(ent->d_name[0]))
+            continue;
+
+        int pid = atoi(ent->d_name);
+        seen.insert(pid);
+
+        if (m_table.find(pid) != m_table.end())
+            continue;
+
+        if (add(pid) && count)
+            ++m_forks;
+    }
+    closedir(dir);
+
+    std::vector<int> gone;
+    for (std::map<int, process>::const_iterator it = m_table.begin(); it != m_table.end(); ++it) {
+        if (seen.find((*it).first) == seen.end())
+            gone.push_back((*it).first);
+    }
+
+    unsigned long long now = clock_ns(CLOCK_MONOTONIC);
+    for (std::vector<int>::const_iterator it = gone.begin(); it != gone.end(); ++it) {
+        remove(*it, now);
+        if (count)
+            ++m_exits;
+    }
+
+    return 0;
+}
+
+bool Processes::add(int pid)
+{
+    pid_stat st;
+    if (read_pid_stat(pid, st))
+        return false;
+
+    process p;
+    p.comm = st.comm;
+    p.start_ns = start_to_monotonic(st.starttime);
+    m_table[pid] = p;
+
+    return true;
+}
+
+void Processes::remove(int pid, unsigned long long when_ns)
+{
+    std::map<int, process>::iterator it = m_table.find(pid);
+    if (it == m_table.end())
+        return;
+
+    const process &p = (*it).second;
+    if (when_ns >= p.start_ns && when_ns - p.start_ns < m_short_lived_threshold * 1e9)
+        ++m_short_lived[p.comm.size() ? p.comm : "unknown"];
+
+    m_table.erase(it);
+}
+
+} // namespace sysmon
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <boost/thread.hpp>
+#include <diagnostic_updater/diagnostic_updater.h>
+
+namespace sysmon {
+
+class Processes {
+    /*
+     * Tracks process creation and exit and publishes via ROS diagnostics.
+     *
+     * Events are taken from the kernel proc connector (PROC_EVENT_FORK, EXEC
+     * and EXIT) to maintain an incremental process table.  This catches
+     * processes too short-lived to ever be seen by a scan, and
+     * /proc/[pid]/stat is only read for processes when they exec.  Events are
+     * consumed by a listener thread so that the name of a new command can be
+     * read before it exits.
+     * Subscribing requires CAP_NET_ADMIN, without it (or when disabled) the
+     * table is maintained by diffing the pids listed in /proc each cycle.
+     * The table is also resynchronized this way if the kernel drops events.
+     *
+     * ROS Parameters:
+     *
+     * ~/process/connector:     Use the proc connector when permitted.
+     *                          Default true.
+     *
+     * ~/process/short_lived:   Processes exiting within this many seconds of
+     *                          being created are counted as short-lived.
+     *                          Default 1.0.
+     *
+     * ~/process/top:           Number of short-lived process names to
+     *                          publish.  Default 5.
+     */
+    public:
+        /*
+         * Constructor
+         */
+        Processes();
+
+        ~Processes();
+
+        /*
+         * Update the ROS diagnostics.
+         */
+        void ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw);
+
+    private:
+        struct process {
+            std::string         comm;
+            unsigned long long  start_ns;
+        };
+
+        /*
+         * Subscribe to the proc connector.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int open_connector();
+
+        /*
+         * Listener thread, applies proc connector events until m_running is
+         * cleared.
+         */
+        void listen();
+
+        /*
+         * Apply all pending proc connector events to the table.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int drain_connector();
+
+        /*
+         * Diff the pids in /proc against the table.
+         *
+         * @param count - Count new pids as forks.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int scan(bool count);
+
+        /*
+         * Add a process to the table, reading its name and start time from
+         * /proc/[pid]/stat.  Called with m_lock held.
+         *
+         * @return  - false if the process has already gone.
+         */
+        bool add(int pid);
+
+        /*
+         * Remove a process from the table, noting it if short-lived.  Called
+         * with m_lock held.
+         *
+         * @param when_ns   - Exit time on the monotonic clock.
+         */
+        void remove(int pid, unsigned long long when_ns);
+
+        Processes(const Processes &);
+        Processes & operator=(const Processes &);
+
+        boost::thread                       m_thread;
+        volatile bool                       m_running;
+
+        /* Protects everything below */
+        boost::mutex                        m_lock;
+
+        /* Closed and set to -1 by the listener if the connector fails */
+        int                                 m_sock;
+        int                                 m_connector_err;
+        std::map<int, process>              m_table;
+        std::map<std::string, unsigned int> m_short_lived;
+
+        unsigned long       m_forks;
+        unsigned long       m_execs;
+        unsigned long       m_exits;
+        double              m_last;
+
+        double              m_short_lived_threshold;
+        int                 m_top;
+};
+
+} // namespace sysmon
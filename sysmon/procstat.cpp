@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "procstat.hpp"
+
+namespace sysmon {
+
+int parse_pid_stat(const char *data, size_t len, pid_stat &st)
+{
+    const char *end = data + len;
+    const char *open = static_cast<const char *>(memchr(data, '(', len));
+    const char *close = NULL;
+
+    for (const char *p = end; p > data; --p) {
+        if (p[-1] == ')') {
+            close = p - 1;
+            break;
+        }
+    }
+
+    if (!open || !close || close < open)
+        return EINVAL;
+
+    st.pid = strtol(data, NULL, 10);
+    st.state = '?';
+    st.ppid = st.processor = 0;
+    st.minflt = st.majflt = st.utime = st.stime = st.starttime = 0;
+    st.num_threads = st.rss = 0;
+    st.comm.assign(open + 1, close - open - 1);
+
+    /* Field 3, the state, follows the command name */
+    const char *p = close + 1;
+    unsigned int field = 2;
+
+    while (p < end && field < 39) {
+        while (p < end && *p == ' ')
+            ++p;
+        if (p >= end)
+            break;
+
+        ++field;
+        switch (field) {
+            case 3:     st.state = *p; break;
+            case 4:     st.ppid = strtol(p, NULL, 10); break;
+            case 10:    st.minflt = strtoull(p, NULL, 10); break;
+            case 12:    st.majflt = strtoull(p, NULL, 10); break;
+            case 14:    st.utime = strtoull(p, NULL, 10); break;
+            case 15:    st.stime = strtoull(p, NULL, 10); break;
+            case 20:    st.num_threads = strtol(p, NULL, 10); break;
+            case 22:    st.starttime = strtoull(p, NULL, 10); break;
+            case 24:    st.rss = strtol(p, NULL, 10); break;
+            case 39:    st.processor = strtol(p, NULL, 10); break;
+        }
+
+        const char *next = static_cast<const char *>(memchr(p, ' ', end - p));
+        p = next ? next : end;
+    }
+
+    return field >= 24 ? 0 : EINVAL;
+}
+
+int read_pid_stat(int pid, pid_stat &st)
+{
+    char path[64];
+    char buf[1024];
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return errno;
+
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    int r = n < 0 ? errno : 0;
+    close(fd);
+
+    if (r)
+        return r;
+
+    buf[n] = '\0';
+    return parse_pid_stat(buf, n, st);
+}
+
+} // namespace sysmon
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+
+namespace sysmon {
+
+/*
+ * Fields of interest from /proc/[pid]/stat or /proc/[pid]/task/[tid]/stat.
+ * Times are in clock ticks, rss in pages.
+ */
+struct pid_stat {
+    int                 pid;
+    std::string         comm;
+    char                state;
+    int                 ppid;
+    unsigned long long  minflt;
+    unsigned long long  majflt;
+    unsigned long long  utime;
+    unsigned long long  stime;
+    long                num_threads;
+    unsigned long long  starttime;
+    long                rss;
+    int                 processor;
+};
+
+/*
+ * Parse the contents of a stat file.  The command name may itself contain
+ * spaces and parentheses so the fields are located from the last ')'.
+ * data[len] must be '\0', the numbers are parsed with strtol(3).
+ *
+ * @return  - 0 on success, EINVAL if the contents are malformed.
+ */
+int parse_pid_stat(const char *data, size_t len, pid_stat &st);
+
+/*
+ * Read and parse /proc/[pid]/stat.
+ *
+ * @return  - 0 on success, appropriate errno otherwise.
+ */
+int read_pid_stat(int pid, pid_stat &st);
+
+} // namespace sysmon
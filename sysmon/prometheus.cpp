@@ -0,0 +1,418 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+
+#include "clock.hpp"
+#include "prometheus.hpp"
+#include "status.hpp"
+
+namespace sysmon {
+
+namespace {
+
+/* Connections beyond this are closed as soon as they are accepted */
+const size_t max_connections = 64;
+
+/* Seconds a scraper gets to send its request and read the response */
+const double connection_timeout = 10;
+
+/*
+ * Append text to a metric name, lower case with anything that is not a
+ * letter or digit collapsed into a single '_'.
+ */
+void append_name(std::string &name, const std::string &text)
+{
+    for (std::string::const_iterator it = text.begin(); it != text.end(); ++it) {
+        if (isalnum(*it))
+            name += tolower(*it);
+        else if (name.size() && name[name.size() - 1] != '_')
+            name += '_';
+    }
+
+    if (name.size() && name[name.size() - 1] == '_')
+        name.erase(name.size() - 1);
+}
+
+/*
+ * Append a label value with backslash, double quote and newline escaped.
+ */
+void append_label(std::string &labels, const std::string &value)
+{
+    for (std::string::const_iterator it = value.begin(); it != value.end(); ++it) {
+        if (*it == '\\' || *it == '"')
+            labels += '\\';
+        if (*it == '\n')
+            labels += "\\n";
+        else
+            labels += *it;
+    }
+}
+
+void render_header(std::string &header, const char *status, size_t len)
+{
+    char buf[256];
+    int n = snprintf(buf, sizeof(buf),
+            "HTTP/1.1 %s\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: %zu\r\n"
+            "Connection: close\r\n"
+            "\r\n",
+            status, len);
+    header.assign(buf, n);
+}
+
+} // namespace
+
+Prometheus::Prometheus() :
+    m_sock(-1),
+    m_port(0),
+    m_sorted(true),
+    m_current(new response()),
+    m_scrapes(0),
+    m_running(false)
+{
+    std::string address = "127.0.0.1";
+
+    ros::param::get("~prometheus/port", m_port);
+    ros::param::get("~prometheus/address", address);
+
+    render_header(m_current->header, "200 OK", 0);
+
+    boost::shared_ptr<response> not_found(new response());
+    not_found->body = "Not found, try /metrics\n";
+    render_header(not_found->header, "404 Not Found", not_found->body.size());
+    m_not_found = not_found;
+
+    if (m_port <= 0)
+        return;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(m_port);
+    if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+        ROS_ERROR("%s:  Invalid ~prometheus/address %s", __func__, address.c_str());
+        return;
+    }
+
+    m_sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_sock < 0) {
+        ROS_ERROR("%s:  Failed to create socket, errno %d", __func__, errno);
+        return;
+    }
+
+    int one = 1;
+    setsockopt(m_sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    if (bind(m_sock, (struct sockaddr *)&addr, sizeof(addr)) || listen(m_sock, 16)) {
+        ROS_ERROR("%s:  Failed to listen on %s:%d, errno %d", __func__, address.c_str(), m_port, errno);
+        close(m_sock);
+        m_sock = -1;
+        return;
+    }
+
+    m_running = true;
+    m_thread = boost::thread(&Prometheus::serve, this);
+}
+
+Prometheus::~Prometheus()
+{
+    m_running = false;
+    m_thread.join();
+
+    for (std::vector<connection>::iterator it = m_connections.begin(); it != m_connections.end(); ++it)
+        close((*it).fd);
+
+    if (m_sock >= 0)
+        close(m_sock);
+}
+
+bool Prometheus::enabled() const
+{
+    return m_sock >= 0;
+}
+
+void Prometheus::add(const std::string &task, const std::string &key, double value)
+{
+    std::map<std::string, std::map<std::string, unsigned int> >::iterator t = m_ids.find(task);
+    unsigned int id;
+
+    if (t != m_ids.end()) {
+        std::map<std::string, unsigned int>::const_iterator k = (*t).second.find(key);
+        id = k != (*t).second.end() ? (*k).second : add_series(task, key);
+    } else {
+        id = add_series(task, key);
+    }
+
+    m_values[id] = value;
+}
+
+unsigned int Prometheus::add_series(const std::string &task, const std::string &key)
+{
+    series s;
+    std::string::size_type dash = task.find(" - ");
+
+    s.metric = "sysmon_";
+    append_name(s.metric, task.substr(0, dash));
+    s.metric += '_';
+    append_name(s.metric, key);
+
+    if (dash != std::string::npos) {
+        s.labels = "{source=\"";
+        append_label(s.labels, task.substr(dash + 3));
+        s.labels += "\"}";
+    }
+
+    unsigned int id = m_series.size();
+    m_series.push_back(s);
+    m_values.push_back(std::numeric_limits<double>::quiet_NaN());
+    m_order.push_back(id);
+    m_ids[task][key] = id;
+    m_sorted = false;
+
+    return id;
+}
+
+bool Prometheus::by_metric::operator()(unsigned int a, unsigned int b) const
+{
+    int r = (*s)[a].metric.compare((*s)[b].metric);
+    return r ? r < 0 : (*s)[a].labels < (*s)[b].labels;
+}
+
+int Prometheus::commit()
+{
+    if (!m_sorted) {
+        by_metric cmp;
+        cmp.s = &m_series;
+        std::sort(m_order.begin(), m_order.end(), cmp);
+        m_sorted = true;
+    }
+
+    m_render.clear();
+
+    const std::string *group = NULL;
+    for (std::vector<unsigned int>::const_iterator it = m_order.begin(); it != m_order.end(); ++it) {
+        double v = m_values[*it];
+        if (std::isnan(v))
+            continue;
+
+        const series &s = m_series[*it];
+        if (!group || *group != s.metric) {
+            m_render += "# TYPE ";
+            m_render += s.metric;
+            m_render += " untyped\n";
+            group = &s.metric;
+        }
+
+        char num[32];
+        int n = snprintf(num, sizeof(num), " %.15g\n", v);
+
+        m_render += s.metric;
+        m_render += s.labels;
+        m_render.append(num, n);
+
+        m_values[*it] = std::numeric_limits<double>::quiet_NaN();
+    }
+
+    boost::mutex::scoped_lock lock(m_lock);
+
+    /* Reuse the published buffers unless a scrape is still sending them */
+    if (!m_current.unique())
+        m_current.reset(new response());
+
+    m_current->body.swap(m_render);
+    render_header(m_current->header, "200 OK", m_current->body.size());
+
+    return 0;
+}
+
+void Prometheus::ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+
+    dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+
+    size_t body;
+    {
+        boost::mutex::scoped_lock lock(m_lock);
+        body = m_current->body.size();
+    }
+
+    values.add("port", m_port);
+    values.add("series", m_series.size());
+    values.add("body (bytes)", body);
+    values.add("scrapes", m_scrapes);
+}
+
+void Prometheus::serve()
+{
+    std::vector<struct pollfd> pfds;
+
+    while (m_running) {
+        pfds.resize(m_connections.size() + 1);
+        pfds[0].fd = m_sock;
+        pfds[0].events = POLLIN;
+        for (unsigned int i = 0; i < m_connections.size(); ++i) {
+            pfds[i + 1].fd = m_connections[i].fd;
+            pfds[i + 1].events = m_connections[i].out ? POLLOUT : POLLIN;
+        }
+
+        /* Wake periodically to notice shutdown and stale connections */
+        int r = poll(&pfds[0], pfds.size(), 200);
+        if (r < 0 && errno != EINTR) {
+            ROS_ERROR("%s:  poll failed, errno %d", __func__, errno);
+            return;
+        }
+
+        double now = monotonic_seconds();
+
+        for (unsigned int i = m_connections.size(); i-- > 0; ) {
+            connection &c = m_connections[i];
+            short revents = r > 0 ? pfds[i + 1].revents : 0;
+            bool open = true;
+
+            /* Checked first so a client trickling bytes cannot hold a slot */
+            if (now - c.opened > connection_timeout)
+                open = false;
+            else if (revents & (POLLERR | POLLHUP | POLLNVAL))
+                open = false;
+            else if (revents & POLLIN)
+                open = receive(c);
+            else if (revents & POLLOUT)
+                open = send(c);
+
+            if (!open) {
+                close(c.fd);
+                m_connections.erase(m_connections.begin() + i);
+            }
+        }
+
+        if (r <= 0 || !(pfds[0].revents & POLLIN))
+            continue;
+
+        for (;;) {
+            int fd = accept4(m_sock, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+                break;
+
+            if (m_connections.size() >= max_connections) {
+                close(fd);
+                continue;
+            }
+
+            connection c;
+            c.fd = fd;
+            c.len = 0;
+            c.sent = 0;
+            c.opened = now;
+            m_connections.push_back(c);
+        }
+    }
+}
+
+bool Prometheus::receive(connection &c)
+{
+    ssize_t n = recv(c.fd, c.request + c.len, sizeof(c.request) - 1 - c.len, 0);
+    if (n < 0)
+        return errno == EAGAIN || errno == EINTR;
+    if (n == 0)
+        return false;
+
+    c.len += n;
+    c.request[c.len] = '\0';
+
+    /* Only the request line matters, the rest of the headers are ignored */
+    if (!strstr(c.request, "\r\n\r\n") && !strstr(c.request, "\n\n")) {
+        return c.len < sizeof(c.request) - 1;
+    }
+
+    static const char get[] = "GET /metrics";
+    char next = c.request[sizeof(get) - 1];
+
+    if (!strncmp(c.request, get, sizeof(get) - 1) && (next == ' ' || next == '?' || next == '\r' || next == '\n')) {
+        boost::mutex::scoped_lock lock(m_lock);
+        c.out = m_current;
+        ++m_scrapes;
+    } else {
+        c.out = m_not_found;
+    }
+
+    return send(c);
+}
+
+bool Prometheus::send(connection &c)
+{
+    const response &r = *c.out;
+    size_t total = r.header.size() + r.body.size();
+    struct iovec iov[2];
+    int n = 0;
+
+    if (c.sent < r.header.size()) {
+        iov[n].iov_base = const_cast<char *>(r.header.data() + c.sent);
+        iov[n].iov_len = r.header.size() - c.sent;
+        ++n;
+    }
+
+    size_t body = c.sent > r.header.size() ? c.sent - r.header.size() : 0;
+    if (body < r.body.size()) {
+        iov[n].iov_base = const_cast<char *>(r.body.data() + body);
+        iov[n].iov_len = r.body.size() - body;
+        ++n;
+    }
+
+    ssize_t w = n ? writev(c.fd, iov, n) : 0;
+    if (w < 0)
+        return errno == EAGAIN || errno == EINTR;
+
+    c.sent += w;
+    if (c.sent < total)
+        return true;
+
+    /* Done, let the scraper see the end of the response before closing */
+    shutdown(c.fd, SHUT_WR);
+    c.out.reset();
+    return false;
+}
+
+} // namespace sysmon
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <diagnostic_updater/diagnostic_updater.h>
+
+#include "sink.hpp"
+
+namespace sysmon {
+
+class Prometheus : public Sink {
+    /*
+     * Serves the samples of the last cycle at /metrics in the Prometheus
+     * text exposition format.  The response is rendered once per cycle by
+     * commit(), scrapes only hand the rendered header and body to writev(),
+     * so the cost of a scrape does not depend on what is being exported.
+     *
+     * A sample added as "<task> - <name>: <key>" is exported as
+     * sysmon_<task>_<key>{source="<name>"}, "<task>: <key>" as
+     * sysmon_<task>_<key>.
+     *
+     * Connections are served by a single thread polling non-blocking
+     * sockets.  A buffer is only reallocated when a slow scraper is still
+     * sending the previous body at the end of a cycle.
+     *
+     * ROS Parameters:
+     *
+     * ~/prometheus/port:       TCP port to listen on.  Default 0, disabled.
+     *
+     * ~/prometheus/address:    Address to listen on.  Default 127.0.0.1.
+     */
+    public:
+        /*
+         * Constructor
+         */
+        Prometheus();
+
+        ~Prometheus();
+
+        /*
+         * Whether the endpoint is being served.
+         */
+        bool enabled() const;
+
+        using Sink::add;
+        void add(const std::string &task, const std::string &key, double value);
+
+        /*
+         * Render the samples added since the last commit and serve them to
+         * following scrapes.
+         */
+        int commit();
+
+        /*
+         * Update the ROS diagnostics.
+         */
+        void ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw);
+
+    private:
+        struct series {
+            std::string         metric;
+            std::string         labels;
+        };
+
+        struct response {
+            std::string         header;
+            std::string         body;
+        };
+
+        struct connection {
+            int                 fd;
+            char                request[1024];
+            size_t              len;
+            boost::shared_ptr<const response> out;
+            size_t              sent;
+            double              opened;
+        };
+
+        /*
+         * Orders series by metric so that every metric is exported as one
+         * group.
+         */
+        struct by_metric {
+            const std::vector<series> *s;
+
+            bool operator()(unsigned int a, unsigned int b) const;
+        };
+
+        /*
+         * Register a series, deriving its metric name and labels.
+         */
+        unsigned int add_series(const std::string &task, const std::string &key);
+
+        /*
+         * Server thread, accepts and answers scrapes until m_running is
+         * cleared.
+         */
+        void serve();
+
+        /*
+         * Read from and answer a connection.
+         *
+         * @return  - false once the connection should be closed.
+         */
+        bool receive(connection &c);
+        bool send(connection &c);
+
+        Prometheus(const Prometheus &);
+        Prometheus & operator=(const Prometheus &);
+
+        int                                 m_sock;
+        int                                 m_port;
+
+        std::vector<series>                 m_series;
+        std::map<std::string, std::map<std::string, unsigned int> > m_ids;
+        std::vector<double>                 m_values;
+        std::vector<unsigned int>           m_order;
+        bool                                m_sorted;
+        std::string                         m_render;
+
+        boost::shared_ptr<response>         m_current;
+        boost::shared_ptr<const response>   m_not_found;
+
+        std::vector<connection>             m_connections;
+        volatile unsigned long              m_scrapes;
+
+        boost::thread                       m_thread;
+        volatile bool                       m_running;
+        boost::mutex                        m_lock;
+};
+
+} // namespace sysmon
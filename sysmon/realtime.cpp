@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <dirent.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include <sstream>
+#include <vector>
+
+#include "realtime.hpp"
+#include "rosadapter.hpp"
+#include "status.hpp"
+
+namespace sysmon {
+
+namespace {
+
+/*
+ * Ids of every thread of the process, sched_setaffinity(2) and
+ * sched_setscheduler(2) only change the thread they are given.
+ */
+int list_threads(std::vector<pid_t> &tids)
+{
+    DIR *dir = opendir("/proc/self/task");
+    if (!dir)
+        return errno;
+
+    struct dirent *ent;
+    while ((ent = readdir(dir))) {
+        if (isdigit(ent->d_name[0]))
+            tids.push_back(atoi(ent->d_name));
+    }
+    closedir(dir);
+
+    return 0;
+}
+
+} // namespace
+
+RealTime::RealTime() :
+    m_mlock(false),
+    m_err(0)
+{
+    int r;
+
+    ros::param::get("~rt/policy", m_policy);
+    ros::param::get("~rt/mlock", m_mlock);
+
+    if ((r = set_affinity()))
+        m_err = r;
+
+    if ((r = set_policy()))
+        m_err = r;
+
+    if (m_mlock && mlockall(MCL_CURRENT | MCL_FUTURE)) {
+        m_err = errno;
+        ROS_ERROR("%s:  Failed to lock memory, errno %d", __func__, m_err);
+    }
+}
+
+void RealTime::ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+
+    if (m_err)
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Failed to apply ~rt settings");
+    else
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    values.add("cpus", m_cpus.size() ? m_cpus : "all");
+    values.add("policy", m_policy.size() ? m_policy : "default");
+    values.add("mlock", m_mlock);
+    values.add("major faults", usage.ru_majflt);
+    values.add("minor faults", usage.ru_minflt);
+}
+
+int RealTime::set_affinity()
+{
+    std::vector<int> cpus;
+    int r;
+
+    if ((r = param_cpus("~rt/cpus", cpus)) || cpus.empty())
+        return r;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    std::ostringstream s;
+    for (unsigned int i = 0; i < cpus.size(); ++i) {
+        CPU_SET(cpus[i], &set);
+        s << (i ? "," : "") << cpus[i];
+    }
+    m_cpus = s.str();
+
+    std::vector<pid_t> tids;
+    if ((r = list_threads(tids))) {
+        ROS_ERROR("%s:  Failed to list threads, errno %d", __func__, r);
+        return r;
+    }
+
+    /* A thread exiting meanwhile fails with ESRCH */
+    for (unsigned int i = 0; i < tids.size(); ++i) {
+        if (sched_setaffinity(tids[i], sizeof(set), &set) && errno != ESRCH) {
+            r = errno;
+            ROS_ERROR("%s:  Failed to pin thread %d to cpus %s, errno %d", __func__, tids[i], m_cpus.c_str(), r);
+            return r;
+        }
+    }
+
+    return 0;
+}
+
+int RealTime::set_policy()
+{
+    int policy;
+
+    if (m_policy.empty())
+        return 0;
+    else if (m_policy == "batch")
+        policy = SCHED_BATCH;
+    else if (m_policy == "idle")
+        policy = SCHED_IDLE;
+    else {
+        ROS_ERROR("%s:  Unknown ~rt/policy %s", __func__, m_policy.c_str());
+        return EINVAL;
+    }
+
+    struct sched_param param;
+    param.sched_priority = 0;
+
+    std::vector<pid_t> tids;
+    int r = list_threads(tids);
+    if (r) {
+        ROS_ERROR("%s:  Failed to list threads, errno %d", __func__, r);
+        return r;
+    }
+
+    for (unsigned int i = 0; i < tids.size(); ++i) {
+        if (sched_setscheduler(tids[i], policy, &param) && errno != ESRCH) {
+            r = errno;
+            ROS_ERROR("%s:  Failed to set ~rt/policy %s on thread %d, errno %d", __func__, m_policy.c_str(), tids[i], r);
+            return r;
+        }
+    }
+
+    return 0;
+}
+
+} // namespace sysmon
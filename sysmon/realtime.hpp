@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <diagnostic_updater/diagnostic_updater.h>
+
+namespace sysmon {
+
+class RealTime {
+    /*
+     * Keeps sysmon out of the way of real-time work sharing the machine.
+     * The node can be pinned to housekeeping cpus, moved to a background
+     * scheduling class and have its memory locked so a sample never waits
+     * on a page fault.  The constructor applies the settings to every thread
+     * of the process, those roscpp started with the NodeHandle included.
+     * Threads started afterwards inherit them.
+     *
+     * The collectors parse in place and reuse their strings, after the first
+     * cycle sampling does not allocate.
+     *
+     * ROS Parameters:
+     *
+     * ~/rt/cpus:       List of cpus to run on, each entry either a cpu
+     *                  number or a range like "2-3".  Default empty, all.
+     *
+     * ~/rt/policy:     Scheduling policy, "batch" (SCHED_BATCH) or "idle"
+     *                  (SCHED_IDLE).  Default empty, unchanged.
+     *
+     * ~/rt/mlock:      Lock all current and future memory with mlockall(2).
+     *                  Default false.
+     */
+    public:
+        /*
+         * Constructor
+         */
+        RealTime();
+
+        /*
+         * Update the ROS diagnostics.
+         */
+        void ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw);
+
+    private:
+        /*
+         * Pin every thread to the cpus listed in ~rt/cpus.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int set_affinity();
+
+        /*
+         * Switch every thread to the scheduling policy in ~rt/policy.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int set_policy();
+
+        std::string         m_cpus;
+        std::string         m_policy;
+        bool                m_mlock;
+
+        int                 m_err;
+};
+
+} // namespace sysmon
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <time.h>
+
+#include "recorder.hpp"
+#include "status.hpp"
+
+namespace sysmon {
+
+Recorder::Recorder() :
+    m_enabled(false),
+    m_frames(0),
+    m_err(0)
+{
+    int size = 16;
+
+    if (!ros::param::get("~recorder/path", m_path) || m_path.empty())
+        return;
+    ros::param::get("~recorder/size", size);
+
+    int r = m_ring.open(m_path, (size_t)size << 20);
+    if (r) {
+        ROS_ERROR("%s:  Failed to open %s, errno %d", __func__, m_path.c_str(), r);
+        return;
+    }
+
+    const std::vector<std::string> &series = m_ring.series();
+    for (unsigned int i = 0; i < series.size(); ++i)
+        m_ids[series[i]] = i;
+    m_frame.assign(series.size(), std::numeric_limits<double>::quiet_NaN());
+
+    m_enabled = true;
+}
+
+bool Recorder::enabled() const
+{
+    return m_enabled;
+}
+
+void Recorder::add(const std::string &task, const std::string &key, double value)
+{
+    if (!m_enabled)
+        return;
+
+    /* Reuses m_name so a known series is looked up without allocating */
+    m_name.assign(task);
+    m_name += ": ";
+    m_name += key;
+    std::map<std::string, int>::iterator it = m_ids.find(m_name);
+
+    if (it == m_ids.end()) {
+        int id = m_ring.add_series(m_name);
+        if (id < 0)
+            ROS_ERROR("%s:  Unable to record '%s', errno %d", __func__, m_name.c_str(), -id);
+
+        /* Failures are remembered too so they are only logged once */
+        it = m_ids.insert(std::make_pair(m_name, id)).first;
+        if (id >= 0)
+            m_frame.resize(id + 1, std::numeric_limits<double>::quiet_NaN());
+    }
+
+    if ((*it).second >= 0)
+        m_frame[(*it).second] = value;
+}
+
+int Recorder::commit()
+{
+    if (!m_enabled)
+        return 0;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    m_err = m_ring.append((int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000, m_frame);
+    if (m_err)
+        ROS_ERROR("%s:  Failed to record to %s, errno %d", __func__, m_path.c_str(), m_err);
+    else
+        ++m_frames;
+
+    std::fill(m_frame.begin(), m_frame.end(), std::numeric_limits<double>::quiet_NaN());
+    return m_err;
+}
+
+void Recorder::ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+
+    if (m_err)
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, strerror(m_err));
+    else
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+
+    values.add("path", m_path);
+    values.add("size (kB)", m_ring.size() >> 10);
+    values.add("series", m_ring.series().size());
+    values.add("frames recorded", m_frames);
+    if (m_frames)
+        values.add("bytes per frame", (double)m_ring.written() / m_frames);
+}
+
+} // namespace sysmon
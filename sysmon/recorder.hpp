@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <diagnostic_updater/diagnostic_updater.h>
+
+#include "ringfile.hpp"
+#include "sink.hpp"
+
+namespace sysmon {
+
+class Recorder : public Sink {
+    /*
+     * Keeps a local history of collector samples in a RingFile so the state
+     * of the system leading up to an incident can be inspected afterwards
+     * with sysmon_history.  Collectors add the values of their last update
+     * each cycle, named "<diagnostic task>: <key>", and commit() writes them
+     * as one frame.
+     *
+     * ROS Parameters:
+     *
+     * ~/recorder/path: File to record to.  Recording is disabled when unset.
+     *
+     * ~/recorder/size: Size of the file in MB.  Default 16.
+     */
+    public:
+        /*
+         * Constructor
+         */
+        Recorder();
+
+        /*
+         * Whether a file is being recorded to.
+         */
+        bool enabled() const;
+
+        /*
+         * Add a sample to the current frame.
+         */
+        using Sink::add;
+        void add(const std::string &task, const std::string &key, double value);
+
+        /*
+         * Write the current frame to the file.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int commit();
+
+        /*
+         * Update the ROS diagnostics.
+         */
+        void ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw);
+
+    private:
+        RingFile                    m_ring;
+        std::string                 m_path;
+        bool                        m_enabled;
+
+        std::map<std::string, int>  m_ids;
+        std::string                 m_name;
+        std::vector<double>         m_frame;
+
+        unsigned long               m_frames;
+        int                         m_err;
+};
+
+} // namespace sysmon
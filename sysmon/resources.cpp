@@ -0,0 +1,410 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "clock.hpp"
+#include "parse.hpp"
+#include "procstat.hpp"
+#include "resources.hpp"
+#include "status.hpp"
+
+namespace sysmon {
+
+namespace {
+
+/*
+ * Read the next entries of the directory fd into buf with getdents64(2).
+ *
+ * @return  - Bytes read, 0 at the end, negative errno on failure.
+ */
+long read_dents(int fd, std::vector<char> &buf)
+{
+    long n = syscall(SYS_getdents64, fd, &buf[0], buf.size());
+    return n < 0 ? -errno : n;
+}
+
+const struct dirent64 * dent(const std::vector<char> &buf, long offset)
+{
+    return reinterpret_cast<const struct dirent64 *>(&buf[offset]);
+}
+
+bool is_dot(const char *name)
+{
+    return name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]));
+}
+
+double percent(unsigned long long used, unsigned long long limit)
+{
+    return limit ? 100.0 * used / limit : 0;
+}
+
+} // namespace
+
+Resources::Resources(FileSet &files) :
+    m_files(&files),
+    m_file_nr(files.add("/proc/sys/fs/file-nr")),
+    m_inode_nr(files.add("/proc/sys/fs/inode-nr")),
+    m_pid_max(files.add("/proc/sys/kernel/pid_max")),
+    m_threads_max(files.add("/proc/sys/kernel/threads-max")),
+    m_loadavg(files.add("/proc/loadavg")),
+    m_max_user_instances(files.add("/proc/sys/fs/inotify/max_user_instances")),
+    m_max_user_watches(files.add("/proc/sys/fs/inotify/max_user_watches")),
+    m_failed(false),
+    m_files_used(0),
+    m_files_max(0),
+    m_threads(0),
+    m_threads_limit(0),
+    m_inodes(0),
+    m_inodes_unused(0),
+    m_scanned(false),
+    m_inotify_instances(0),
+    m_inotify_watches(0),
+    m_proc_dents(32768),
+    m_dents(32768),
+    m_last_scan(0),
+    m_level(diagnostic_msgs::DiagnosticStatus::OK),
+    m_warn(80),
+    m_error(95),
+    m_top(5),
+    m_scan_period(10)
+{
+    ros::param::get("~resources/warn", m_warn);
+    ros::param::get("~resources/error", m_error);
+    ros::param::get("~resources/top", m_top);
+    ros::param::get("~resources/scan_period", m_scan_period);
+}
+
+void Resources::ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+
+    if (update()) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Update failed");
+        return;
+    }
+
+    double now = monotonic_seconds();
+    if (m_top > 0 && (!m_scanned || now - m_last_scan >= m_scan_period)) {
+        m_scanned = !scan();
+        m_last_scan = now;
+    }
+
+    m_level = diagnostic_msgs::DiagnosticStatus::OK;
+    m_message = "OK";
+
+    double files = percent(m_files_used, m_files_max);
+    double threads = percent(m_threads, m_threads_limit);
+    double instances = percent(m_inotify_instances, value(m_max_user_instances));
+    double watches = percent(m_inotify_watches, value(m_max_user_watches));
+
+    check("File handles", files);
+    check("Threads", threads);
+    if (m_scanned) {
+        check("Inotify instances", instances);
+        check("Inotify watches", watches);
+
+        for (std::vector<open_files>::const_iterator it = m_processes.begin(); it != m_processes.end(); ++it)
+            check(("Open files of " + (*it).comm).c_str(), percent((*it).count, (*it).limit));
+    }
+
+    dsw.summary(m_level, m_message);
+
+    values.add("file handles", m_files_used);
+    values.add("file handles max", m_files_max);
+    values.add("file handles (%)", files);
+    values.add("threads", m_threads);
+    values.add("threads max", m_threads_limit);
+    values.add("threads (%)", threads);
+    values.add("inodes", m_inodes);
+    values.add("inodes unused", m_inodes_unused);
+
+    if (!m_scanned)
+        return;
+
+    values.add("inotify instances", m_inotify_instances);
+    values.add("inotify instances (%)", instances);
+    values.add("inotify watches", m_inotify_watches);
+    values.add("inotify watches (%)", watches);
+
+    for (std::vector<open_files>::const_iterator it = m_processes.begin(); it != m_processes.end(); ++it) {
+        std::ostringstream s;
+        s << "open files - " << (*it).comm << " [" << (*it).pid << "]";
+        values.add(s.str(), (*it).count);
+        if ((*it).limit)
+            values.add(s.str() + " (%)", percent((*it).count, (*it).limit));
+    }
+}
+
+int Resources::update()
+{
+    m_failed = false;
+
+    /* 1234	0	9223372036854775807, the unused count is always 0 since 2.6 */
+    m_files_used = value(m_file_nr, 0) - value(m_file_nr, 1);
+    m_files_max = value(m_file_nr, 2);
+
+    m_inodes = value(m_inode_nr, 0);
+    m_inodes_unused = value(m_inode_nr, 1);
+
+    /* A new thread needs both a pid and to be under threads-max */
+    m_threads_limit = std::min(value(m_pid_max), value(m_threads_max));
+
+    /* 0.20 0.18 0.12 1/80 11206, the second half of the fourth field */
+    const char *data;
+    size_t len;
+    if (m_files->get(m_loadavg, data, len)) {
+        m_failed = true;
+    } else {
+        const char *p = data, *end = line_end(data, data + len), *word = NULL;
+        for (unsigned int i = 0; i < 4 && next_word(p, end, word); ++i)
+            ;
+        const char *slash = word ? static_cast<const char *>(memchr(word, '/', p - word)) : NULL;
+        m_threads = slash ? strtoull(slash + 1, NULL, 10) : 0;
+    }
+
+    if (m_failed) {
+        ROS_ERROR("%s:  Failed to read /proc/sys", __func__);
+        return EIO;
+    }
+
+    return 0;
+}
+
+unsigned long long Resources::value(int source, unsigned int index)
+{
+    const char *data;
+    size_t len;
+    if (m_files->get(source, data, len)) {
+        m_failed = true;
+        return 0;
+    }
+
+    const char *p = data, *end = line_end(data, data + len), *word;
+    for (unsigned int i = 0; next_word(p, end, word); ++i) {
+        if (i == index)
+            return strtoull(word, NULL, 10);
+    }
+
+    return 0;
+}
+
+int Resources::scan()
+{
+    int proc = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (proc < 0) {
+        int r = errno;
+        ROS_ERROR("%s:  Failed to open /proc, errno %d", __func__, r);
+        return r;
+    }
+
+    uid_t uid = geteuid();
+    m_inotify_instances = 0;
+    m_inotify_watches = 0;
+    m_processes.clear();
+
+    long n;
+    while ((n = read_dents(proc, m_proc_dents)) > 0) {
+        for (long off = 0; off < n; off += dent(m_proc_dents, off)->d_reclen) {
+            const char *name = dent(m_proc_dents, off)->d_name;
+            if (!isdigit(name[0]))
+                continue;
+
+            int dir = openat(proc, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (dir < 0)
+                continue;
+
+            /* Only readable for our own processes without CAP_SYS_PTRACE */
+            int fds = openat(dir, "fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fds >= 0) {
+                long c = count(fds);
+                if (c >= 0) {
+                    open_files p;
+                    p.pid = atoi(name);
+                    p.count = c;
+                    p.limit = 0;
+                    m_processes.push_back(p);
+                }
+
+                struct stat st;
+                if (!fstat(dir, &st) && st.st_uid == uid && !lseek(fds, 0, SEEK_SET))
+                    count_inotify(dir, fds);
+
+                close(fds);
+            }
+            close(dir);
+        }
+    }
+    close(proc);
+
+    if (n < 0) {
+        ROS_ERROR("%s:  Failed to list /proc, errno %ld", __func__, -n);
+        return -n;
+    }
+
+    unsigned int top = std::min((size_t)m_top, m_processes.size());
+    std::partial_sort(m_processes.begin(), m_processes.begin() + top, m_processes.end());
+    m_processes.resize(top);
+
+    for (std::vector<open_files>::iterator it = m_processes.begin(); it != m_processes.end(); ++it)
+        describe(*it);
+
+    return 0;
+}
+
+long Resources::count(int fd)
+{
+    long entries = 0;
+    long n;
+
+    while ((n = read_dents(fd, m_dents)) > 0) {
+        for (long off = 0; off < n; off += dent(m_dents, off)->d_reclen) {
+            if (!is_dot(dent(m_dents, off)->d_name))
+                ++entries;
+        }
+    }
+
+    return n < 0 ? n : entries;
+}
+
+void Resources::count_inotify(int proc, int fds)
+{
+    static const char inotify[] = "anon_inode:inotify";
+    static const char watch[] = "\ninotify wd:";
+
+    long n;
+    while ((n = read_dents(fds, m_dents)) > 0) {
+        for (long off = 0; off < n; off += dent(m_dents, off)->d_reclen) {
+            const char *name = dent(m_dents, off)->d_name;
+            char buf[4096];
+
+            if (is_dot(name))
+                continue;
+
+            ssize_t len = readlinkat(fds, name, buf, sizeof(buf));
+            if (len != sizeof(inotify) - 1 || memcmp(buf, inotify, len))
+                continue;
+
+            ++m_inotify_instances;
+
+            /* One "inotify wd:" line per watch, there may be thousands */
+            char path[64];
+            snprintf(path, sizeof(path), "fdinfo/%s", name);
+            int fd = openat(proc, path, O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                continue;
+
+            unsigned int matched = 1;
+            while ((len = read(fd, buf, sizeof(buf))) > 0) {
+                for (ssize_t i = 0; i < len; ++i) {
+                    if (buf[i] == watch[matched])
+                        ++matched;
+                    else
+                        matched = buf[i] == '\n';
+
+                    if (matched == sizeof(watch) - 1) {
+                        ++m_inotify_watches;
+                        matched = 0;
+                    }
+                }
+            }
+            close(fd);
+        }
+    }
+}
+
+void Resources::describe(open_files &p)
+{
+    pid_stat st;
+    if (!read_pid_stat(p.pid, st))
+        p.comm = st.comm;
+    else
+        p.comm = "unknown";
+
+    /* Max open files            1024                 524288               files */
+    static const char label[] = "Max open files";
+    char path[64];
+    char buf[4096];
+
+    snprintf(path, sizeof(path), "/proc/%d/limits", p.pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    ssize_t len = read(fd, buf, sizeof(buf));
+    close(fd);
+    if (len <= 0)
+        return;
+
+    const char *end = buf + len;
+    for (const char *line = buf; line < end; ++line) {
+        const char *eol = line_end(line, end);
+        const char *word;
+
+        if (eol - line > (ssize_t)sizeof(label) && !memcmp(line, label, sizeof(label) - 1)) {
+            line += sizeof(label) - 1;
+            if (next_word(line, eol, word))
+                p.limit = strtoul(word, NULL, 10);
+            break;
+        }
+        line = eol;
+    }
+}
+
+void Resources::check(const char *what, double usage)
+{
+    unsigned char level;
+
+    if (usage > m_error)
+        level = diagnostic_msgs::DiagnosticStatus::ERROR;
+    else if (usage > m_warn)
+        level = diagnostic_msgs::DiagnosticStatus::WARN;
+    else
+        return;
+
+    if (level <= m_level)
+        return;
+
+    m_level = level;
+    assign_format(m_message, "%s at %.0f%%", what, usage);
+}
+
+} // namespace sysmon
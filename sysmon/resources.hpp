@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <diagnostic_updater/diagnostic_updater.h>
+
+#include "fileset.hpp"
+
+namespace sysmon {
+
+class Resources {
+    /*
+     * Monitors kernel resources that run out long before the cpu or memory
+     * does and publishes via ROS diagnostics:  file handles
+     * (/proc/sys/fs/file-nr), threads against pid_max and threads-max,
+     * inodes (/proc/sys/fs/inode-nr), inotify instances and watches of the
+     * user sysmon runs as, and the open files of the processes holding the
+     * most against their own RLIMIT_NOFILE.
+     *
+     * Open files are counted by listing /proc/[pid]/fd with getdents64(2)
+     * into a reused buffer, nothing is stat'ed or resolved except the
+     * descriptors of processes of our own user, which are checked for
+     * inotify instances.  As this touches every process it is only done every
+     * ~/resources/scan_period seconds.
+     *
+     * ROS Parameters:
+     *
+     * ~/resources/warn:        Usage in % of a limit above which the status
+     *                          is raised to WARN.  Default 80.
+     *
+     * ~/resources/error:       Usage in % of a limit above which the status
+     *                          is raised to ERROR.  Default 95.
+     *
+     * ~/resources/top:         Number of processes with the most open files
+     *                          to publish.  Default 5, 0 disables the scan.
+     *
+     * ~/resources/scan_period: Seconds between scans of the open files.
+     *                          Default 10.
+     */
+    public:
+        /*
+         * Constructor
+         *
+         * @param files - Set the /proc/sys files are registered with and
+         *                read from.
+         */
+        Resources(FileSet &files);
+
+        /*
+         * Update the ROS diagnostics.
+         */
+        void ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw);
+
+    private:
+        struct open_files {
+            int                 pid;
+            unsigned long       count;
+            unsigned long       limit;
+            std::string         comm;
+
+            bool operator<(const open_files &other) const
+            {
+                return count > other.count;
+            }
+        };
+
+        /*
+         * Read the latest values of the /proc/sys files.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int update();
+
+        /*
+         * Count the open files of every process and the inotify usage of our
+         * user, keeping the m_top processes with the most open files.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int scan();
+
+        /*
+         * Count the entries other than . and .. of the directory fd.
+         *
+         * @return  - Number of entries, negative errno on failure.
+         */
+        long count(int fd);
+
+        /*
+         * Count the inotify instances and watches among the open files of a
+         * process.
+         *
+         * @param proc  - /proc/[pid] directory.
+         * @param fds   - /proc/[pid]/fd directory.
+         */
+        void count_inotify(int proc, int fds);
+
+        /*
+         * Fill in the command name and open file limit of a process.
+         */
+        void describe(open_files &p);
+
+        /*
+         * Raise the status to the level of a usage.
+         */
+        void check(const char *what, double usage);
+
+        /*
+         * First value of a single line /proc/sys file.
+         */
+        unsigned long long value(int source, unsigned int index = 0);
+
+        FileSet *           m_files;
+        int                 m_file_nr;
+        int                 m_inode_nr;
+        int                 m_pid_max;
+        int                 m_threads_max;
+        int                 m_loadavg;
+        int                 m_max_user_instances;
+        int                 m_max_user_watches;
+        bool                m_failed;
+
+        unsigned long long  m_files_used;
+        unsigned long long  m_files_max;
+        unsigned long long  m_threads;
+        unsigned long long  m_threads_limit;
+        unsigned long long  m_inodes;
+        unsigned long long  m_inodes_unused;
+
+        /* As of the last scan */
+        bool                m_scanned;
+        unsigned long       m_inotify_instances;
+        unsigned long       m_inotify_watches;
+        std::vector<open_files> m_processes;
+        std::vector<char>   m_proc_dents;
+        std::vector<char>   m_dents;
+        double              m_last_scan;
+
+        unsigned char       m_level;
+        std::string         m_message;
+
+        double              m_warn;
+        double              m_error;
+        int                 m_top;
+        double              m_scan_period;
+};
+
+} // namespace sysmon
@@ -0,0 +1,637 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "ringfile.hpp"
+
+namespace sysmon {
+
+namespace {
+
+const char          FILE_MAGIC[8] = { 'S', 'Y', 'S', 'M', 'O', 'N', 'T', 'S' };
+const uint32_t      FILE_VERSION = 1;
+const uint32_t      BLOCK_MAGIC = 0x53594d42;
+const size_t        BLOCK_SIZE = 65536;
+
+/* The file header and series table fill the first block */
+const size_t        TABLE_OFFSET = 64;
+const size_t        TABLE_SIZE = BLOCK_SIZE - TABLE_OFFSET;
+
+/* Largest timestamp and value encodings, see RingFile::append() */
+const size_t        WORST_TIME_BITS = 4 + 32;
+const size_t        WORST_VALUE_BITS = 2 + 5 + 6 + 64;
+
+/*
+ * Append the low n bits of value, most significant first.  The buffer must
+ * be zeroed past pos.
+ */
+void put_bits(uint8_t *buf, size_t &pos, uint64_t value, unsigned int n)
+{
+    while (n) {
+        unsigned int room = 8 - (pos & 7);
+        unsigned int take = n < room ? n : room;
+        uint8_t bits = (value >> (n - take)) & ((1u << take) - 1);
+
+        buf[pos >> 3] |= bits << (room - take);
+        pos += take;
+        n -= take;
+    }
+}
+
+struct bit_reader {
+    const uint8_t *         buf;
+    size_t                  pos;
+    size_t                  end;
+    bool                    overrun;
+
+    bit_reader(const uint8_t *b, size_t e) : buf(b), pos(0), end(e), overrun(false) {}
+
+    uint64_t get(unsigned int n)
+    {
+        uint64_t v = 0;
+
+        if (pos + n > end) {
+            overrun = true;
+            return 0;
+        }
+
+        while (n) {
+            unsigned int room = 8 - (pos & 7);
+            unsigned int take = n < room ? n : room;
+
+            v = (v << take) | ((buf[pos >> 3] >> (room - take)) & ((1u << take) - 1));
+            pos += take;
+            n -= take;
+        }
+        return v;
+    }
+
+    int64_t get_signed(unsigned int n)
+    {
+        uint64_t v = get(n);
+        if (v & (1ULL << (n - 1)))
+            return (int64_t)v - (int64_t)(1ULL << n);
+        return v;
+    }
+};
+
+} // namespace
+
+RingFile::RingFile() :
+    m_fd(-1),
+    m_map(NULL),
+    m_size(0),
+    m_writable(false),
+    m_block(0),
+    m_seq(0),
+    m_gen(0),
+    m_bits(0),
+    m_synced(0),
+    m_count(0),
+    m_nseries(0),
+    m_last_time(0),
+    m_last_delta(0),
+    m_crc_bytes(0),
+    m_written(0)
+{}
+
+RingFile::~RingFile()
+{
+    close();
+}
+
+int RingFile::open(const std::string &path, size_t size)
+{
+    close();
+
+    size -= size % BLOCK_SIZE;
+    if (size < 3 * BLOCK_SIZE)
+        return EINVAL;
+
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m_fd < 0)
+        return errno;
+
+    struct stat st;
+    if (fstat(m_fd, &st)) {
+        int r = errno;
+        close();
+        return r;
+    }
+
+    bool fresh = (size_t)st.st_size != size;
+    if (fresh && ftruncate(m_fd, 0)) {
+        int r = errno;
+        close();
+        return r;
+    }
+
+    /* Allocate up front, running out of space through the mapping is SIGBUS */
+    int r = posix_fallocate(m_fd, 0, size);
+    if (r) {
+        close();
+        return r;
+    }
+
+    m_size = size;
+    r = map(O_RDWR, PROT_READ | PROT_WRITE);
+    if (r)
+        return r;
+
+    if (fresh || !valid_header())
+        init_header();
+
+    load_series();
+
+    /* Continue after the newest block */
+    std::vector<unsigned int> used = blocks();
+    m_block = used.size() ? used.back() : nblocks() - 1;
+    m_seq = used.size() ? header(m_block)->seq : 0;
+    m_nseries = -1;
+    m_buf.assign(BLOCK_SIZE - sizeof(block_header), 0);
+
+    return 0;
+}
+
+int RingFile::open_readonly(const std::string &path)
+{
+    close();
+
+    m_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (m_fd < 0)
+        return errno;
+
+    struct stat st;
+    if (fstat(m_fd, &st)) {
+        int r = errno;
+        close();
+        return r;
+    }
+
+    m_size = st.st_size;
+    if (m_size < 3 * BLOCK_SIZE) {
+        close();
+        return EINVAL;
+    }
+
+    int r = map(O_RDONLY, PROT_READ);
+    if (r)
+        return r;
+
+    if (!valid_header()) {
+        close();
+        return EINVAL;
+    }
+
+    load_series();
+    return 0;
+}
+
+void RingFile::close()
+{
+    if (m_map) {
+        if (m_writable)
+            msync(m_map, m_size, MS_SYNC);
+        munmap(m_map, m_size);
+    }
+    if (m_fd >= 0)
+        ::close(m_fd);
+
+    m_fd = -1;
+    m_map = NULL;
+    m_size = 0;
+    m_writable = false;
+    m_series.clear();
+}
+
+int RingFile::map(int flags, int prot)
+{
+    void *p = mmap(NULL, m_size, prot, MAP_SHARED, m_fd, 0);
+    if (p == MAP_FAILED) {
+        int r = errno;
+        close();
+        return r;
+    }
+
+    m_map = static_cast<uint8_t *>(p);
+    m_writable = flags == O_RDWR;
+    return 0;
+}
+
+bool RingFile::valid_header() const
+{
+    const file_header *fh = reinterpret_cast<const file_header *>(m_map);
+
+    return !memcmp(fh->magic, FILE_MAGIC, sizeof(FILE_MAGIC))
+        && fh->version == FILE_VERSION
+        && fh->block_size == BLOCK_SIZE
+        && fh->size == m_size
+        && fh->nblocks == nblocks()
+        && fh->table_size == TABLE_SIZE
+        && fh->table_len <= TABLE_SIZE;
+}
+
+void RingFile::init_header()
+{
+    file_header *fh = reinterpret_cast<file_header *>(m_map);
+
+    memset(m_map, 0, BLOCK_SIZE);
+    for (unsigned int i = 0; i < nblocks(); ++i)
+        memset(header(i), 0, sizeof(block_header));
+
+    fh->version = FILE_VERSION;
+    fh->block_size = BLOCK_SIZE;
+    fh->size = m_size;
+    fh->nblocks = nblocks();
+    fh->table_size = TABLE_SIZE;
+    __sync_synchronize();
+    memcpy(fh->magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+}
+
+void RingFile::load_series()
+{
+    const volatile file_header *fh = reinterpret_cast<const volatile file_header *>(m_map);
+
+    uint32_t nseries = fh->nseries;
+    __sync_synchronize();
+    uint32_t len = fh->table_len;
+    if (len > TABLE_SIZE)
+        len = TABLE_SIZE;
+
+    const char *table = reinterpret_cast<const char *>(m_map + TABLE_OFFSET);
+    const char *end = table + len;
+
+    m_series.clear();
+    while (m_series.size() < nseries && table < end) {
+        const char *nul = static_cast<const char *>(memchr(table, '\0', end - table));
+        if (!nul)
+            break;
+
+        m_series.push_back(std::string(table, nul));
+        table = nul + 1;
+    }
+}
+
+int RingFile::add_series(const std::string &name)
+{
+    if (!m_map || !m_writable)
+        return -EBADF;
+
+    file_header *fh = reinterpret_cast<file_header *>(m_map);
+    size_t max = (m_buf.size() * 8 - WORST_TIME_BITS) / WORST_VALUE_BITS;
+
+    if (m_series.size() >= max || fh->table_len + name.size() + 1 > TABLE_SIZE)
+        return -ENOSPC;
+
+    memcpy(m_map + TABLE_OFFSET + fh->table_len, name.c_str(), name.size() + 1);
+    __sync_synchronize();
+    fh->table_len += name.size() + 1;
+    __sync_synchronize();
+    fh->nseries = m_series.size() + 1;
+
+    m_series.push_back(name);
+    return m_series.size() - 1;
+}
+
+const std::vector<std::string> & RingFile::series()
+{
+    if (m_map && !m_writable)
+        load_series();
+    return m_series;
+}
+
+int RingFile::append(int64_t time, const std::vector<double> &values)
+{
+    if (!m_map || !m_writable)
+        return EBADF;
+
+    if (values.size() != m_series.size())
+        return EINVAL;
+
+    int64_t delta = time - m_last_time;
+    int64_t dod = delta - m_last_delta;
+
+    if (m_nseries != values.size()
+            || m_bits + WORST_TIME_BITS + WORST_VALUE_BITS * m_nseries > m_buf.size() * 8
+            || (m_count && (delta < 0 || (int32_t)dod != dod)))
+        start_block();
+
+    uint8_t *buf = &m_buf[0];
+
+    if (!m_count) {
+        put_bits(buf, m_bits, time, 64);
+        m_last_delta = 0;
+    } else {
+        if (dod == 0) {
+            put_bits(buf, m_bits, 0x0, 1);
+        } else if (dod >= -64 && dod < 64) {
+            put_bits(buf, m_bits, 0x2, 2);
+            put_bits(buf, m_bits, dod, 7);
+        } else if (dod >= -256 && dod < 256) {
+            put_bits(buf, m_bits, 0x6, 3);
+            put_bits(buf, m_bits, dod, 9);
+        } else if (dod >= -2048 && dod < 2048) {
+            put_bits(buf, m_bits, 0xe, 4);
+            put_bits(buf, m_bits, dod, 12);
+        } else {
+            put_bits(buf, m_bits, 0xf, 4);
+            put_bits(buf, m_bits, dod, 32);
+        }
+        m_last_delta = delta;
+    }
+    m_last_time = time;
+
+    for (unsigned int i = 0; i < m_nseries; ++i) {
+        uint64_t v;
+        memcpy(&v, &values[i], sizeof(v));
+
+        if (!m_count) {
+            put_bits(buf, m_bits, v, 64);
+            m_last_value[i] = v;
+            continue;
+        }
+
+        uint64_t x = v ^ m_last_value[i];
+        m_last_value[i] = v;
+
+        if (!x) {
+            put_bits(buf, m_bits, 0x0, 1);
+            continue;
+        }
+
+        unsigned int leading = std::min(__builtin_clzll(x), 31);
+        unsigned int trailing = __builtin_ctzll(x);
+
+        if (leading >= m_leading[i] && trailing >= m_trailing[i]) {
+            /* Meaningful bits fit in the previous window */
+            put_bits(buf, m_bits, 0x2, 2);
+            put_bits(buf, m_bits, x >> m_trailing[i], 64 - m_leading[i] - m_trailing[i]);
+        } else {
+            unsigned int len = 64 - leading - trailing;
+
+            put_bits(buf, m_bits, 0x3, 2);
+            put_bits(buf, m_bits, leading, 5);
+            put_bits(buf, m_bits, len - 1, 6);
+            put_bits(buf, m_bits, x >> trailing, len);
+            m_leading[i] = leading;
+            m_trailing[i] = trailing;
+        }
+    }
+
+    ++m_count;
+    commit_block();
+    return 0;
+}
+
+void RingFile::start_block()
+{
+    m_block = (m_block + 1) % nblocks();
+
+    block_header *h = header(m_block);
+    h->seq = 0;
+    __sync_synchronize();
+    memset(h->slot, 0, sizeof(h->slot));
+    h->nseries = m_series.size();
+    h->magic = BLOCK_MAGIC;
+    __sync_synchronize();
+    h->seq = ++m_seq;
+
+    std::fill(m_buf.begin(), m_buf.end(), 0);
+    m_bits = 0;
+    m_synced = 0;
+    m_count = 0;
+    m_gen = 0;
+    m_nseries = m_series.size();
+    m_last_time = 0;
+    m_last_delta = 0;
+    m_last_value.assign(m_nseries, 0);
+    m_leading.assign(m_nseries, 64);
+    m_trailing.assign(m_nseries, 64);
+    m_crc.reset();
+    m_crc_bytes = 0;
+}
+
+void RingFile::commit_block()
+{
+    size_t from = m_synced / 8;
+    size_t full = m_bits / 8;
+    size_t bytes = (m_bits + 7) / 8;
+
+    memcpy(data(m_block) + from, &m_buf[from], bytes - from);
+    m_written += m_bits - m_synced;
+
+    m_crc.process_bytes(&m_buf[m_crc_bytes], full - m_crc_bytes);
+    m_crc_bytes = full;
+
+    boost::crc_32_type crc = m_crc;
+    if (bytes > full)
+        crc.process_byte(m_buf[full]);
+
+    /* Only the older slot is touched, the other stays valid throughout */
+    commit *c = &header(m_block)->slot[++m_gen & 1];
+    c->gen = 0;
+    __sync_synchronize();
+    c->count = m_count;
+    c->bits = m_bits;
+    c->crc = crc.checksum();
+    __sync_synchronize();
+    c->gen = m_gen;
+
+    m_synced = m_bits;
+}
+
+bool RingFile::committed(const block_header *h, const uint8_t *data, commit &c) const
+{
+    bool found = false;
+
+    for (unsigned int i = 0; i < 2; ++i) {
+        commit s = h->slot[i];
+
+        if (!s.gen || s.bits > (BLOCK_SIZE - sizeof(block_header)) * 8)
+            continue;
+        if (found && s.gen < c.gen)
+            continue;
+
+        /* Bits past the commit may already belong to the next frame */
+        size_t full = s.bits / 8;
+        boost::crc_32_type crc;
+        crc.process_bytes(data, full);
+        if (s.bits & 7)
+            crc.process_byte(data[full] & (0xff << (8 - (s.bits & 7))));
+
+        if (crc.checksum() != s.crc)
+            continue;
+
+        c = s;
+        found = true;
+    }
+
+    return found;
+}
+
+std::vector<unsigned int> RingFile::blocks() const
+{
+    std::vector<std::pair<uint64_t, unsigned int> > seqs;
+
+    for (unsigned int i = 0; i < nblocks(); ++i) {
+        const block_header *h = header(i);
+        commit c;
+
+        if (h->magic != BLOCK_MAGIC || !h->seq)
+            continue;
+        if (!committed(h, data(i), c) || !c.count)
+            continue;
+
+        seqs.push_back(std::make_pair(h->seq, i));
+    }
+
+    std::sort(seqs.begin(), seqs.end());
+
+    std::vector<unsigned int> ret;
+    for (std::vector<std::pair<uint64_t, unsigned int> >::const_iterator it = seqs.begin();
+            it != seqs.end();
+            ++it) {
+        ret.push_back((*it).second);
+    }
+    return ret;
+}
+
+int RingFile::decode(unsigned int block, std::vector<int64_t> &times,
+        std::vector<double> &values, unsigned int &nseries) const
+{
+    times.clear();
+    values.clear();
+    nseries = 0;
+
+    if (!m_map || block >= nblocks())
+        return EINVAL;
+
+    /* Work from a copy, a writer may reuse the block while it is decoded */
+    std::vector<uint8_t> copy(reinterpret_cast<const uint8_t *>(header(block)),
+            reinterpret_cast<const uint8_t *>(header(block)) + BLOCK_SIZE);
+    const block_header *h = reinterpret_cast<const block_header *>(&copy[0]);
+    const uint8_t *buf = &copy[sizeof(block_header)];
+    commit c;
+
+    if (h->magic != BLOCK_MAGIC || !h->seq || !committed(h, buf, c))
+        return ENOENT;
+
+    nseries = h->nseries;
+
+    bit_reader in(buf, c.bits);
+    int64_t time = 0;
+    int64_t delta = 0;
+    std::vector<uint64_t> last(nseries, 0);
+    std::vector<unsigned int> leading(nseries, 0);
+    std::vector<unsigned int> trailing(nseries, 0);
+
+    for (uint32_t frame = 0; frame < c.count; ++frame) {
+        if (!frame) {
+            time = in.get(64);
+        } else {
+            int64_t dod;
+
+            if (!in.get(1))
+                dod = 0;
+            else if (!in.get(1))
+                dod = in.get_signed(7);
+            else if (!in.get(1))
+                dod = in.get_signed(9);
+            else if (!in.get(1))
+                dod = in.get_signed(12);
+            else
+                dod = in.get_signed(32);
+
+            delta += dod;
+            time += delta;
+        }
+        times.push_back(time);
+
+        for (unsigned int i = 0; i < nseries; ++i) {
+            if (!frame) {
+                last[i] = in.get(64);
+            } else if (in.get(1)) {
+                if (in.get(1)) {
+                    leading[i] = in.get(5);
+                    unsigned int len = in.get(6) + 1;
+                    trailing[i] = 64 - leading[i] - len;
+                    if (len + leading[i] > 64)
+                        return EINVAL;
+                }
+                last[i] ^= in.get(64 - leading[i] - trailing[i]) << trailing[i];
+            }
+
+            double v;
+            memcpy(&v, &last[i], sizeof(v));
+            values.push_back(v);
+        }
+
+        if (in.overrun)
+            return EINVAL;
+    }
+
+    return 0;
+}
+
+size_t RingFile::size() const
+{
+    return m_size;
+}
+
+unsigned int RingFile::nblocks() const
+{
+    return m_size / BLOCK_SIZE - 1;
+}
+
+size_t RingFile::written() const
+{
+    return (m_written + 7) / 8;
+}
+
+RingFile::block_header * RingFile::header(unsigned int block) const
+{
+    return reinterpret_cast<block_header *>(m_map + (block + 1) * BLOCK_SIZE);
+}
+
+uint8_t * RingFile::data(unsigned int block) const
+{
+    return m_map + (block + 1) * BLOCK_SIZE + sizeof(block_header);
+}
+
+} // namespace sysmon
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <boost/crc.hpp>
+
+namespace sysmon {
+
+class RingFile {
+    /*
+     * Fixed size, memory mapped ring of compressed time series samples.
+     *
+     * The file starts with a header and a table of series names, their
+     * position in the table is the series id.  The rest of the file is split
+     * into blocks that are reused oldest first.  Each block holds frames of
+     * one timestamp and a value for every series known when the block was
+     * started.  The first frame of a block is stored raw, after that
+     * timestamps are stored as a delta-of-delta and values as the XOR with
+     * the previous value of the same series, both with variable length codes.
+     *
+     * A block header has two commit slots holding the frame count, bit length
+     * and a crc32 of the block data.  Appending a frame only adds bits past
+     * the committed length and then overwrites the older slot, so a writer
+     * dying at any point leaves the other slot describing valid data.
+     *
+     * This class does not depend on ROS so that it may be used by the reader
+     * tool.
+     */
+    public:
+        /*
+         * Constructor
+         */
+        RingFile();
+
+        ~RingFile();
+
+        /*
+         * Open a file for appending, creating it if needed.  An existing file
+         * of the same size and format keeps its series and history, anything
+         * else is reinitialized.
+         *
+         * @param path  - File to map.
+         * @param size  - Size of the file in bytes.
+         *
+         * @return      - 0 on success, appropriate errno otherwise.
+         */
+        int open(const std::string &path, size_t size);
+
+        /*
+         * Open an existing file for reading.  The file may be open for
+         * appending by another process at the same time.
+         *
+         * @return      - 0 on success, appropriate errno otherwise.
+         */
+        int open_readonly(const std::string &path);
+
+        void close();
+
+        /*
+         * Register a new series.
+         *
+         * @return  - id of the series, negative errno on failure.
+         */
+        int add_series(const std::string &name);
+
+        /*
+         * Names of the series, indexed by id.  Reloaded from the file when
+         * opened read-only.
+         */
+        const std::vector<std::string> & series();
+
+        /*
+         * Append a frame.  NaN marks a series without a sample.
+         *
+         * @param time      - Milliseconds since the epoch.
+         * @param values    - One value per registered series.
+         *
+         * @return          - 0 on success, appropriate errno otherwise.
+         */
+        int append(int64_t time, const std::vector<double> &values);
+
+        /*
+         * Get the blocks holding committed frames, oldest first.
+         */
+        std::vector<unsigned int> blocks() const;
+
+        /*
+         * Decode every committed frame of a block.  Values are returned row
+         * major, nseries per frame.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int decode(unsigned int block, std::vector<int64_t> &times,
+                std::vector<double> &values, unsigned int &nseries) const;
+
+        size_t size() const;
+        unsigned int nblocks() const;
+
+        /*
+         * Number of bytes appended since the file was opened.
+         */
+        size_t written() const;
+
+    private:
+        struct commit {
+            uint32_t            gen;
+            uint32_t            count;
+            uint32_t            bits;
+            uint32_t            crc;
+        };
+
+        struct block_header {
+            uint32_t            magic;
+            uint32_t            nseries;
+            uint64_t            seq;
+            commit              slot[2];
+            uint8_t             pad[16];
+        };
+
+        struct file_header {
+            char                magic[8];
+            uint32_t            version;
+            uint32_t            block_size;
+            uint64_t            size;
+            uint32_t            nblocks;
+            uint32_t            table_size;
+            uint32_t            table_len;
+            uint32_t            nseries;
+        };
+
+        int map(int flags, int prot);
+        bool valid_header() const;
+        void init_header();
+        void load_series();
+
+        block_header * header(unsigned int block) const;
+        uint8_t * data(unsigned int block) const;
+
+        /*
+         * Get the newest slot of a block whose crc matches its data.
+         *
+         * @return  - false if no slot is valid.
+         */
+        bool committed(const block_header *h, const uint8_t *data, commit &c) const;
+
+        /*
+         * Start writing the block following the current one.
+         */
+        void start_block();
+
+        /*
+         * Publish the bits encoded so far through the older commit slot.
+         */
+        void commit_block();
+
+        RingFile(const RingFile &);
+        RingFile & operator=(const RingFile &);
+
+        int                     m_fd;
+        uint8_t *               m_map;
+        size_t                  m_size;
+        bool                    m_writable;
+
+        std::vector<std::string> m_series;
+
+        /* Writer state for the current block */
+        unsigned int            m_block;
+        uint64_t                m_seq;
+        uint32_t                m_gen;
+        std::vector<uint8_t>    m_buf;
+        size_t                  m_bits;
+        size_t                  m_synced;
+        uint32_t                m_count;
+        uint32_t                m_nseries;
+        int64_t                 m_last_time;
+        int64_t                 m_last_delta;
+        std::vector<uint64_t>   m_last_value;
+        std::vector<uint8_t>    m_leading;
+        std::vector<uint8_t>    m_trailing;
+        boost::crc_32_type      m_crc;
+        size_t                  m_crc_bytes;
+        size_t                  m_written;
+};
+
+} // namespace sysmon
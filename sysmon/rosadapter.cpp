@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sched.h>
+
+#include <algorithm>
+#include <sstream>
+#include <XmlRpcValue.h>
+#include <diagnostic_updater/diagnostic_updater.h>
+
+#include "cpuinfo.hpp"
+#include "cputime.hpp"
+#include "diskusage.hpp"
+#include "fileset.hpp"
+#include "interrupts.hpp"
+#include "loadavg.hpp"
+#include "meminfo.hpp"
+#include "netstat.hpp"
+#include "power.hpp"
+#include "rosadapter.hpp"
+#include "status.hpp"
+
+namespace sysmon {
+
+std::set<std::string> param_list(const std::string &name)
+{
+    std::set<std::string> ret;
+
+    if (!ros::param::has(name))
+        return ret;
+
+    XmlRpc::XmlRpcValue list;
+    ros::param::get(name, list);
+    if (list.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+        ROS_ERROR("%s:  Invalid value (not TypeArray) for %s", __func__, name.c_str());
+        return ret;
+    }
+
+    for (int i = 0; i < list.size(); ++i) {
+        if (list[i].getType() != XmlRpc::XmlRpcValue::TypeString)
+            continue;
+
+        ret.insert(static_cast<std::string>(list[i]));
+    }
+    return ret;
+}
+
+int param_cpus(const std::string &name, std::vector<int> &cpus)
+{
+    std::set<std::string> entries = param_list(name);
+    std::set<int> ret;
+
+    for (std::set<std::string>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        const char *s = (*it).c_str();
+        char *end;
+        unsigned long first, last;
+
+        first = last = strtoul(s, &end, 10);
+        if (end != s && *end == '-') {
+            s = end + 1;
+            last = strtoul(s, &end, 10);
+        }
+
+        if (end == s || *end || last < first || last >= CPU_SETSIZE) {
+            ROS_ERROR("%s:  Invalid cpu '%s' in %s", __func__, (*it).c_str(), name.c_str());
+            return EINVAL;
+        }
+
+        for (unsigned long cpu = first; cpu <= last; ++cpu)
+            ret.insert(cpu);
+    }
+
+    cpus.assign(ret.begin(), ret.end());
+    return 0;
+}
+
+void ros_log(log_level level, const char *msg)
+{
+    if (level == LEVEL_ERROR)
+        ROS_ERROR("%s", msg);
+    else
+        ROS_WARN("%s", msg);
+}
+
+void CpuInfo::ros_update(unsigned int proc, diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+
+    if (proc > m_values.size()) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Unknown processor id");
+        return;
+    }
+
+    if (update()) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Update failed");
+        return;
+    }
+
+    dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+    for (cpuinfoIter it = m_values[proc].begin(); it != m_values[proc].end(); ++it) {
+        if (m_whitelist.size()) {
+            if (std::find(m_whitelist.begin(), m_whitelist.end(), (*it).first) != m_whitelist.end())
+                values.add((*it).first, (*it).second);
+        } else {
+            values.add((*it).first, (*it).second);
+        }
+    }
+}
+
+void CpuTime::ros_update(int proc, diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+
+    if (proc > m_values.size() && proc < -1) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Unknown processor id");
+        return;
+    }
+
+    if (update()) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Update failed");
+        return;
+    }
+
+    dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+
+    if (proc == -1) {
+        for (cputimeIter it = m_totals.begin(); it != m_totals.end(); ++it)
+            values.add((*it).first, (*it).second);
+
+        values.add("context switches/s", m_ctxt_rate);
+        values.add("forks/s", m_fork_rate);
+        values.add("interrupts/s", m_intr_rate);
+        values.add("procs_running", m_procs_running);
+        values.add("procs_blocked", m_procs_blocked);
+        if (m_values.size())
+            values.add("run queue per cpu", m_run_queue);
+    } else {
+        for (cputimeIter it = m_values[proc].begin(); it != m_values[proc].end(); ++it)
+            values.add((*it).first, (*it).second);
+    }
+}
+
+void DiskUsage::ros_update(const std::string &disk, diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+
+    if (update()) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Update failed");
+        return;
+    }
+
+    if (m_values.find(disk) == m_values.end()) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Invalid disk name");
+        return;
+    }
+
+    double time_to_full = m_history[disk].time_to_full;
+    if (time_to_full < m_error)
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Filling up");
+    else if (time_to_full < m_warn)
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Filling up");
+    else
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+
+    for (diskusageIter it = m_values[disk].begin(); it != m_values[disk].end(); ++it)
+        values.add((*it).first, (*it).second);
+}
+
+void FileSet::ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+
+    dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+
+    values.add("backend", uring() ? "io_uring" : "pread");
+    values.add("files", m_sources.size());
+    values.add("syscalls per cycle", m_syscalls);
+    values.add("read time (ms)", m_read_time * 1000);
+}
+
+void Interrupts::ros_update(int proc, diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+
+    if (proc < -1 || proc >= (int)m_cpus.size()) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Unknown processor id");
+        return;
+    }
+
+    if (proc == -1 && update()) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Update failed");
+        return;
+    }
+
+    if (proc == -1 && m_imbalanced.size()) {
+        std::ostringstream s;
+        s << "Imbalanced:";
+        for (unsigned int i = 0; i < m_imbalanced.size(); ++i)
+            s << " CPU" << m_cpus[m_imbalanced[i]];
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::WARN, s.str());
+    } else {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+    }
+
+    for (std::vector<source>::const_iterator it = m_sources.begin(); it != m_sources.end(); ++it) {
+        if (proc == -1) {
+            double total = 0;
+            for (unsigned int i = 0; i < (*it).rates.size(); ++i)
+                total += (*it).rates[i];
+            values.add((*it).key, total);
+        } else if ((unsigned int)proc < (*it).rates.size()) {
+            values.add((*it).key, (*it).rates[proc]);
+        }
+    }
+
+    if (proc == -1) {
+        for (unsigned int i = 0; i < m_cpu_rates.size(); ++i)
+            values.add(m_cpu_keys[i], m_cpu_rates[i]);
+    }
+}
+
+void LoadAvg::ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+
+    if (update() || m_load.size() < 3) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Update failed");
+        return;
+    }
+
+    dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+    static const char * names[] = {"1 minute", "5 minute", "15 minute"};
+
+    for (unsigned int i = 0; i < 3; ++i)
+        values.add(names[i], m_load[i]);
+}
+
+void MemInfo::ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+
+    if (update()) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Update failed");
+        return;
+    }
+
+    dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+    for (meminfoIter it = m_values.begin(); it != m_values.end(); ++it) {
+        if (m_whitelist.size()) {
+            if (std::find(m_whitelist.begin(), m_whitelist.end(), (*it).first) != m_whitelist.end())
+                values.add((*it).first, (*it).second);
+        } else {
+            values.add((*it).first, (*it).second);
+        }
+    }
+}
+
+void NetStat::ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+
+    if (update()) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Update failed");
+        return;
+    }
+
+    if (m_rates[TCP_LISTEN_OVERFLOWS] > m_drops_warn || m_rates[TCP_LISTEN_DROPS] > m_drops_warn)
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Listen queue overflows");
+    else if (m_rates[UDP_RCVBUF_ERRORS] > m_drops_warn)
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::WARN, "UDP receive buffer drops");
+    else if (m_retrans > m_retrans_warn)
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::WARN, "TCP retransmits");
+    else
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+
+    values.add("Tcp retransmits (%)", m_retrans);
+    for (unsigned int i = 0; i < NCOUNTERS; ++i)
+        values.add(counter_names[i], m_rates[i]);
+    for (unsigned int i = 0; i < NGAUGES; ++i)
+        values.add(gauge_names[i], m_gauges[i]);
+}
+
+void Power::ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+
+    if (!supported()) {
+        std::string reason = "Unsupported";
+        if (m_err != ENOENT)
+            reason = reason + ", " + strerror(m_err);
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, reason);
+        return;
+    }
+
+    if (update()) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Update failed");
+        return;
+    }
+
+    dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+    for (std::vector<zone>::const_iterator it = m_zones.begin(); it != m_zones.end(); ++it) {
+        values.add((*it).power_key, (*it).power);
+        values.add((*it).energy_key, (*it).energy);
+    }
+}
+
+} // namespace sysmon
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "log.hpp"
+
+namespace sysmon {
+
+/*
+ * Glue between libsysmon and ROS.  rosadapter.cpp also holds the
+ * ros_update() of every libsysmon collector.
+ */
+
+/*
+ * Read a list of strings from the parameter server.
+ *
+ * @param name  - Parameter holding a list of XmlRpcValue::TypeString.
+ *
+ * @return      - The strings, empty if the parameter is not set.
+ */
+std::set<std::string> param_list(const std::string &name);
+
+/*
+ * Read a list of cpus from the parameter server.
+ *
+ * @param name  - Parameter holding a list of XmlRpcValue::TypeString, each
+ *                a cpu number or a range such as "2-3".
+ * @param cpus  - Sorted cpus listed, empty if the parameter is not set.
+ *
+ * @return      - 0 on success, EINVAL if an entry is not a valid cpu.
+ */
+int param_cpus(const std::string &name, std::vector<int> &cpus);
+
+/*
+ * Log handler forwarding libsysmon messages to rosconsole, see
+ * set_log_handler().
+ */
+void ros_log(log_level level, const char *msg);
+
+} // namespace sysmon
@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cmath>
+
+#include "clock.hpp"
+#include "parse.hpp"
+#include "rules.hpp"
+
+namespace sysmon {
+
+namespace {
+
+struct metric_info {
+    const char *        name;
+    const char *        format;
+};
+
+const metric_info metrics[Rules::NMETRICS] = {
+    { "cpu_usage",          "CPU usage %.1f%%" },
+    { "processor_usage",    "CPU usage %.1f%%" },
+    { "mem_available",      "Memory available %.1f%%" },
+    { "load_per_core",      "Load %.2f per core" },
+    { "disk_usage",         "Disk usage %.1f%%" },
+};
+
+bool starts_with(const std::string &s, const std::string &prefix)
+{
+    return !s.compare(0, prefix.size(), prefix);
+}
+
+} // namespace
+
+Rules::Rules() :
+    m_nproc(0)
+{
+    for (unsigned int i = 0; i < NMETRICS; ++i) {
+        rule &r = m_rules[i];
+        std::string ns = std::string("~rules/") + metrics[i].name + "/";
+
+        /* An unset threshold is never passed */
+        r.warn = r.error = i == MEM_AVAILABLE ? -HUGE_VAL : HUGE_VAL;
+        r.hysteresis = 0;
+        r.duration = 0;
+        r.enabled = ros::param::has(ns + "warn") || ros::param::has(ns + "error");
+
+        ros::param::get(ns + "warn", r.warn);
+        ros::param::get(ns + "error", r.error);
+        ros::param::get(ns + "hysteresis", r.hysteresis);
+        ros::param::get(ns + "duration", r.duration);
+    }
+}
+
+bool Rules::enabled() const
+{
+    for (unsigned int i = 0; i < NMETRICS; ++i) {
+        if (m_rules[i].enabled)
+            return true;
+    }
+    return false;
+}
+
+void Rules::add(DiagnosticPublisher &updater, const std::string &name,
+        const diagnostic_updater::TaskFunction &task)
+{
+    updater.add(name, boost::bind(&Rules::ros_update, this, name, task, _1));
+}
+
+void Rules::add(const std::string &task, const std::string &key, double value)
+{
+    static const std::string idle("idle");
+    static const std::string iowait("iowait");
+    static const std::string total("total");
+    static const std::string mem_total("MemTotal");
+    static const std::string mem_available("MemAvailable");
+    static const std::string load("1 minute");
+    static const std::string usage("usage");
+
+    /* Most samples do not feed a metric, skip them before the task lookup */
+    if (key != idle && key != iowait && key != total
+            && key != mem_total && key != mem_available
+            && key != load && key != usage)
+        return;
+
+    subject *s = find(task);
+    if (!s)
+        return;
+
+    switch (s->type) {
+        case CPU_USAGE:
+        case PROCESSOR_USAGE:
+            if (key == idle)
+                s->idle = value;
+            else if (key == iowait)
+                s->iowait = value;
+            else if (key == total)
+                s->total = value;
+            break;
+
+        case MEM_AVAILABLE:
+            if (key == mem_total)
+                s->total = value;
+            else if (key == mem_available)
+                s->sample = value;
+            break;
+
+        case LOAD_PER_CORE:
+            if (key == load)
+                s->sample = value;
+            break;
+
+        case DISK_USAGE:
+            if (key == usage)
+                s->sample = value;
+            break;
+
+        default:
+            break;
+    }
+}
+
+int Rules::commit()
+{
+    double now = monotonic_seconds();
+
+    for (std::map<std::string, subject>::iterator it = m_subjects.begin(); it != m_subjects.end(); ++it) {
+        subject &s = (*it).second;
+
+        measure(s);
+        if (m_rules[s.type].enabled && s.valid)
+            evaluate(s, now);
+    }
+
+    return 0;
+}
+
+void Rules::ros_update(const std::string &name, const diagnostic_updater::TaskFunction &task,
+        diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    task(dsw);
+
+    std::map<std::string, subject>::const_iterator it = m_subjects.find(name);
+    if (it != m_subjects.end() && (*it).second.level != diagnostic_msgs::DiagnosticStatus::OK)
+        dsw.mergeSummary((*it).second.level, (*it).second.message);
+}
+
+Rules::subject * Rules::find(const std::string &task)
+{
+    static const std::string cpu_total("CPU Time - Total");
+    static const std::string cpu_prefix("Cpu Time - Processor ");
+    static const std::string memory("Memory");
+    static const std::string load("Load Average");
+    static const std::string disk_prefix("Disk Usage - ");
+
+    std::map<std::string, subject>::iterator it = m_subjects.find(task);
+    if (it != m_subjects.end())
+        return &(*it).second;
+
+    subject s;
+    s.total = s.idle = s.iowait = 0;
+    s.last_total = s.last_idle = 0;
+    s.sample = NAN;
+    s.value = 0;
+    s.valid = false;
+    s.level = s.pending = diagnostic_msgs::DiagnosticStatus::OK;
+    s.since = 0;
+
+    if (task == cpu_total) {
+        s.type = CPU_USAGE;
+    } else if (starts_with(task, cpu_prefix)) {
+        s.type = PROCESSOR_USAGE;
+        ++m_nproc;
+    } else if (task == memory) {
+        s.type = MEM_AVAILABLE;
+    } else if (task == load) {
+        s.type = LOAD_PER_CORE;
+    } else if (starts_with(task, disk_prefix)) {
+        s.type = DISK_USAGE;
+    } else {
+        return NULL;
+    }
+
+    return &(*m_subjects.insert(std::make_pair(task, s)).first).second;
+}
+
+void Rules::measure(subject &s)
+{
+    switch (s.type) {
+        case CPU_USAGE:
+        case PROCESSOR_USAGE: {
+            double total = s.total - s.last_total;
+            double idle = s.idle + s.iowait - s.last_idle;
+
+            s.valid = s.last_total > 0 && total > 0;
+            if (s.valid)
+                s.value = 100 * (total - idle) / total;
+
+            s.last_total = s.total;
+            s.last_idle = s.idle + s.iowait;
+            break;
+        }
+
+        case MEM_AVAILABLE:
+            s.valid = s.total > 0 && !std::isnan(s.sample);
+            if (s.valid)
+                s.value = 100 * s.sample / s.total;
+            break;
+
+        case LOAD_PER_CORE:
+            s.valid = m_nproc && !std::isnan(s.sample);
+            if (s.valid)
+                s.value = s.sample / m_nproc;
+            break;
+
+        default:
+            s.valid = !std::isnan(s.sample);
+            s.value = s.sample;
+            break;
+    }
+}
+
+void Rules::evaluate(subject &s, double now)
+{
+    const rule &r = m_rules[s.type];
+    unsigned char target = diagnostic_msgs::DiagnosticStatus::OK;
+
+    if (past(s.type, s.value, r.error))
+        target = diagnostic_msgs::DiagnosticStatus::ERROR;
+    else if (past(s.type, s.value, r.warn))
+        target = diagnostic_msgs::DiagnosticStatus::WARN;
+
+    /* A level is only left once the value is clear of its threshold by the hysteresis */
+    if (target < s.level) {
+        double margin = s.type == MEM_AVAILABLE ? r.hysteresis : -r.hysteresis;
+
+        if (s.level == diagnostic_msgs::DiagnosticStatus::ERROR && past(s.type, s.value, r.error + margin))
+            target = diagnostic_msgs::DiagnosticStatus::ERROR;
+        else if (target == diagnostic_msgs::DiagnosticStatus::OK && past(s.type, s.value, r.warn + margin))
+            target = diagnostic_msgs::DiagnosticStatus::WARN;
+    }
+
+    /* and only risen to once the value has been past the threshold for the duration */
+    if (target > s.level) {
+        if (s.pending <= s.level)
+            s.since = now;
+        s.pending = target;
+
+        if (now - s.since < r.duration)
+            return;
+    }
+
+    s.pending = s.level = target;
+    if (target != diagnostic_msgs::DiagnosticStatus::OK)
+        assign_format(s.message, metrics[s.type].format, s.value);
+}
+
+bool Rules::past(metric type, double value, double threshold) const
+{
+    return type == MEM_AVAILABLE ? value < threshold : value > threshold;
+}
+
+} // namespace sysmon
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <diagnostic_updater/diagnostic_updater.h>
+
+#include "diagnosticpublisher.hpp"
+#include "sink.hpp"
+
+namespace sysmon {
+
+class Rules : public Sink {
+    /*
+     * Raises the status of the cpu time, memory, load average and disk usage
+     * diagnostics from the samples themselves, so consumers only need to look
+     * at the level.  The samples of each cycle are turned into one metric per
+     * task:
+     *
+     *     cpu_usage        % busy of "CPU Time - Total"
+     *     processor_usage  % busy of each "Cpu Time - Processor N"
+     *     mem_available    MemAvailable in % of MemTotal, "Memory"
+     *     load_per_core    1 minute load divided by the number of cpus,
+     *                      "Load Average"
+     *     disk_usage       % used of each "Disk Usage - <mount>"
+     *
+     * A metric past its warn or error threshold raises the status of its
+     * task, unless ~rules/<metric>/duration is set in which case it has to
+     * stay there that long first.  It only returns to a lower level once it
+     * is back past that level's threshold by ~rules/<metric>/hysteresis, so
+     * a value hovering at a threshold does not flap.
+     *
+     * ROS Parameters:
+     *
+     * ~/rules/<metric>/warn:       Threshold of WARN, a metric without warn
+     *                              or error is not checked.  mem_available is
+     *                              checked for falling below its thresholds,
+     *                              the others for rising above.
+     *
+     * ~/rules/<metric>/error:      Threshold of ERROR.
+     *
+     * ~/rules/<metric>/hysteresis: Margin to clear a threshold by before the
+     *                              level drops.  Default 0.
+     *
+     * ~/rules/<metric>/duration:   Seconds a threshold has to be exceeded for
+     *                              before the level rises.  Default 0.
+     */
+    public:
+        enum metric {
+            CPU_USAGE,
+            PROCESSOR_USAGE,
+            MEM_AVAILABLE,
+            LOAD_PER_CORE,
+            DISK_USAGE,
+            NMETRICS
+        };
+
+        /*
+         * Constructor
+         */
+        Rules();
+
+        /*
+         * Whether any rule is configured.
+         */
+        bool enabled() const;
+
+        /*
+         * Register a diagnostic task with the updater, its status is raised
+         * by the rules of its metric after it runs.
+         */
+        void add(DiagnosticPublisher &updater, const std::string &name,
+                const diagnostic_updater::TaskFunction &task);
+
+        using Sink::add;
+        void add(const std::string &task, const std::string &key, double value);
+
+        /*
+         * Evaluate the rules against the samples added since the last commit.
+         */
+        int commit();
+
+    private:
+        struct rule {
+            bool                enabled;
+            double              warn;
+            double              error;
+            double              hysteresis;
+            double              duration;
+        };
+
+        struct subject {
+            metric              type;
+
+            double              total;
+            double              idle;
+            double              iowait;
+            double              last_total;
+            double              last_idle;
+            double              sample;
+            double              value;
+            bool                valid;
+
+            unsigned char       level;
+            unsigned char       pending;
+            double              since;
+            std::string         message;
+        };
+
+        /*
+         * Run a task and merge the status of its rules into it.
+         */
+        void ros_update(const std::string &name, const diagnostic_updater::TaskFunction &task,
+                diagnostic_updater::DiagnosticStatusWrapper &dsw);
+
+        /*
+         * Find the subject of a task, creating it the first time the task is
+         * seen.
+         *
+         * @return  - Subject or NULL if no rule applies to the task.
+         */
+        subject * find(const std::string &task);
+
+        /*
+         * Compute the metric of a subject from this cycle's samples.
+         */
+        void measure(subject &s);
+
+        /*
+         * Move a subject to the level its metric calls for.
+         */
+        void evaluate(subject &s, double now);
+
+        /*
+         * Whether value is past threshold in the direction of the metric.
+         */
+        bool past(metric type, double value, double threshold) const;
+
+        rule                m_rules[NMETRICS];
+        std::map<std::string, subject> m_subjects;
+        unsigned int        m_nproc;
+};
+
+} // namespace sysmon
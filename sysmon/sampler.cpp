@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include <ros/ros.h>
+
+#include "clock.hpp"
+#include "sampler.hpp"
+#include "status.hpp"
+
+namespace sysmon {
+
+Sampler::Sampler() :
+    m_min_rate(1),
+    m_max_rate(1),
+    m_change(10),
+    m_busy(90),
+    m_decay(10),
+    m_rate(1),
+    m_last(0),
+    m_trigger("none"),
+    m_triggers(0)
+{
+    ros::param::get("~sampling/min_rate", m_min_rate);
+    ros::param::get("~sampling/max_rate", m_max_rate);
+    ros::param::get("~sampling/change", m_change);
+    ros::param::get("~sampling/busy", m_busy);
+    ros::param::get("~sampling/decay", m_decay);
+
+    if (m_min_rate <= 0 || m_max_rate < m_min_rate) {
+        ROS_ERROR("%s:  Invalid ~sampling rates %g-%gHz, using 1Hz", __func__, m_min_rate, m_max_rate);
+        m_min_rate = m_max_rate = 1;
+    }
+    if (m_decay <= 0)
+        m_decay = 10;
+
+    m_rate = std::max(m_min_rate, std::min(m_max_rate, 1.0));
+
+    for (unsigned int i = 0; i < NGAUGES; ++i)
+        m_gauges[i].valid = false;
+}
+
+bool Sampler::adaptive() const
+{
+    return m_min_rate != m_max_rate;
+}
+
+double Sampler::period() const
+{
+    return 1 / m_rate;
+}
+
+void Sampler::add(const std::string &task, const std::string &key, double value)
+{
+    m_builder.add(task, key, value);
+}
+
+int Sampler::commit()
+{
+    m_builder.commit();
+
+    double now = monotonic_seconds();
+    double dt = now - m_last;
+    bool first = m_last == 0;
+    m_last = now;
+
+    if (first)
+        return 0;
+
+    const snapshot &s = m_builder.get();
+    const char *trigger = NULL;
+
+    double memory = s.mem_total ? 100 * (s.mem_total - s.mem_available) / s.mem_total : 0;
+
+    if (s.cpu_usage >= m_busy)
+        trigger = "cpu busy";
+    else if (memory >= m_busy)
+        trigger = "memory busy";
+
+    if (follow(m_gauges[GAUGE_CPU], s.cpu_usage, dt) && !trigger)
+        trigger = "cpu usage";
+    if (follow(m_gauges[GAUGE_MEMORY], memory, dt) && !trigger)
+        trigger = "memory usage";
+    for (unsigned int i = 0; i < s.ndisks && i < SNAPSHOT_MAX_DISKS; ++i) {
+        if (follow(m_gauges[GAUGE_DISK + i], s.disk[i].usage, dt) && !trigger)
+            trigger = "disk usage";
+    }
+
+    if (trigger) {
+        m_rate = m_max_rate;
+        m_trigger = trigger;
+        ++m_triggers;
+    } else {
+        m_rate = std::max(m_min_rate, m_rate * pow(0.5, dt / m_decay));
+    }
+
+    return 0;
+}
+
+void Sampler::ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+
+    dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+
+    values.add("rate (Hz)", m_rate);
+    values.add("min rate (Hz)", m_min_rate);
+    values.add("max rate (Hz)", m_max_rate);
+    values.add("last trigger", m_trigger);
+    values.add("triggers", m_triggers);
+}
+
+bool Sampler::follow(gauge &g, double usage, double dt)
+{
+    if (!g.valid || dt <= 0) {
+        g.fast = g.slow = usage;
+        g.valid = true;
+        return false;
+    }
+
+    g.fast += (usage - g.fast) * (1 - exp(-dt));
+    g.slow += (usage - g.slow) * (1 - exp(-dt / m_decay));
+
+    return fabs(g.fast - g.slow) >= m_change;
+}
+
+} // namespace sysmon
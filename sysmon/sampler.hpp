@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <diagnostic_updater/diagnostic_updater.h>
+
+#include "sink.hpp"
+#include "snapshot.hpp"
+#include "snapshotbuilder.hpp"
+
+namespace sysmon {
+
+class Sampler : public Sink {
+    /*
+     * Adapts the sampling rate of sysmon to what the system is doing.  The
+     * samples of each cycle are built into a snapshot and the cpu, memory
+     * and disk usage are followed with a short (1s) and a long
+     * (~sampling/decay) moving average.  When the two differ by more than
+     * ~sampling/change, or the cpu or memory usage is above ~sampling/busy,
+     * sampling jumps to ~sampling/max_rate.  While nothing triggers the rate
+     * halves every ~sampling/decay seconds, down to ~sampling/min_rate.
+     *
+     * Both rates default to 1Hz, which keeps the fixed one second cycle.
+     *
+     * ROS Parameters:
+     *
+     * ~/sampling/min_rate: Slowest sampling rate in Hz.  Default 1.
+     *
+     * ~/sampling/max_rate: Fastest sampling rate in Hz.  Default 1.
+     *
+     * ~/sampling/change:   Change in % points of the cpu, memory or disk
+     *                      usage considered fast.  Default 10.
+     *
+     * ~/sampling/busy:     Cpu or memory usage in % above which to sample
+     *                      at the fastest rate.  Default 90.
+     *
+     * ~/sampling/decay:    Seconds for the rate to halve once stable.
+     *                      Default 10.
+     */
+    public:
+        /*
+         * Constructor
+         */
+        Sampler();
+
+        /*
+         * Whether the rate adapts, false when min and max rate are equal.
+         */
+        bool adaptive() const;
+
+        /*
+         * Seconds to wait before the next cycle.
+         */
+        double period() const;
+
+        using Sink::add;
+        void add(const std::string &task, const std::string &key, double value);
+
+        /*
+         * Compare the samples added since the last commit with the previous
+         * cycles and pick the rate of the next cycle.
+         */
+        int commit();
+
+        /*
+         * Update the ROS diagnostics.
+         */
+        void ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw);
+
+    private:
+        enum {
+            GAUGE_CPU,
+            GAUGE_MEMORY,
+            GAUGE_DISK,
+            NGAUGES = GAUGE_DISK + SNAPSHOT_MAX_DISKS
+        };
+
+        struct gauge {
+            double              fast;
+            double              slow;
+            bool                valid;
+        };
+
+        /*
+         * Fold a usage into the moving averages of a gauge.
+         *
+         * @return  - true if the usage is changing quickly.
+         */
+        bool follow(gauge &g, double usage, double dt);
+
+        SnapshotBuilder     m_builder;
+        gauge               m_gauges[NGAUGES];
+
+        double              m_min_rate;
+        double              m_max_rate;
+        double              m_change;
+        double              m_busy;
+        double              m_decay;
+
+        double              m_rate;
+        double              m_last;
+        const char *        m_trigger;
+        unsigned long       m_triggers;
+};
+
+} // namespace sysmon
@@ -0,0 +1,863 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * sysmon_scale - measure the cost of a sample cycle as the host grows.
+ * Synthetic /proc and /etc/mtab trees, including /proc/interrupts and
+ * /proc/softirqs a column per cpu wide, are generated for each combination of
+ * cpu and mount counts, and the collect and publish loop of the sysmon node
+ * is run against them through FileSet's root.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <ftw.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <map>
+#include <new>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "clock.hpp"
+#include "cpuinfo.hpp"
+#include "cputime.hpp"
+#include "diskusage.hpp"
+#include "fileset.hpp"
+#include "format.hpp"
+#include "interrupts.hpp"
+#include "loadavg.hpp"
+#include "meminfo.hpp"
+#include "power.hpp"
+#include "sink.hpp"
+
+#ifdef HAVE_DIAGNOSTIC_MSGS
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include "status.hpp"
+#endif
+
+#if __cplusplus >= 201103L
+#define NEW_THROW
+#else
+#define NEW_THROW throw(std::bad_alloc)
+#endif
+
+namespace {
+
+const unsigned int warmup = 10;
+
+/* Calls to operator new, see below */
+unsigned long allocations;
+
+const char meminfo[] =
+    "MemTotal:       263842716 kB\n"
+    "MemFree:        201336424 kB\n"
+    "MemAvailable:   247091920 kB\n"
+    "Buffers:          2412760 kB\n"
+    "Cached:          42011812 kB\n"
+    "SwapCached:             0 kB\n"
+    "Active:          19418340 kB\n"
+    "Inactive:        33864072 kB\n"
+    "Active(anon):     9174572 kB\n"
+    "Inactive(anon):      5272 kB\n"
+    "Active(file):    10243768 kB\n"
+    "Inactive(file):  33858800 kB\n"
+    "Unevictable:        31012 kB\n"
+    "Mlocked:            27940 kB\n"
+    "SwapTotal:        8388604 kB\n"
+    "SwapFree:         8388604 kB\n"
+    "Dirty:                868 kB\n"
+    "Writeback:              0 kB\n"
+    "AnonPages:        8873784 kB\n"
+    "Mapped:           1581332 kB\n"
+    "Shmem:             329464 kB\n"
+    "KReclaimable:     5371020 kB\n"
+    "Slab:             7254480 kB\n"
+    "SReclaimable:     5371020 kB\n"
+    "SUnreclaim:       1883460 kB\n"
+    "KernelStack:        69856 kB\n"
+    "PageTables:        101296 kB\n"
+    "NFS_Unstable:           0 kB\n"
+    "Bounce:                 0 kB\n"
+    "WritebackTmp:           0 kB\n"
+    "CommitLimit:    140309960 kB\n"
+    "Committed_AS:    24434436 kB\n"
+    "VmallocTotal:   34359738367 kB\n"
+    "VmallocUsed:       681224 kB\n"
+    "VmallocChunk:           0 kB\n"
+    "Percpu:            296960 kB\n"
+    "HardwareCorrupted:      0 kB\n"
+    "AnonHugePages:    2099200 kB\n"
+    "ShmemHugePages:         0 kB\n"
+    "ShmemPmdMapped:         0 kB\n"
+    "HugePages_Total:        0\n"
+    "HugePages_Free:         0\n"
+    "HugePages_Rsvd:         0\n"
+    "HugePages_Surp:         0\n"
+    "Hugepagesize:        2048 kB\n"
+    "Hugetlb:                0 kB\n"
+    "DirectMap4k:     15446528 kB\n"
+    "DirectMap2M:    214302720 kB\n"
+    "DirectMap1G:     40894464 kB\n";
+
+const char cpuinfo[] =
+    "vendor_id\t: GenuineIntel\n"
+    "cpu family\t: 6\n"
+    "model\t\t: 143\n"
+    "model name\t: Intel(R) Xeon(R) Platinum 8480+\n"
+    "stepping\t: 8\n"
+    "microcode\t: 0x2b000461\n"
+    "cpu MHz\t\t: 2000.000\n"
+    "cache size\t: 107520 KB\n"
+    "fpu\t\t: yes\n"
+    "fpu_exception\t: yes\n"
+    "cpuid level\t: 32\n"
+    "wp\t\t: yes\n"
+    "flags\t\t: fpu vme de pse tsc msr pae mce cx8 apic sep mtrr pge mca cmov pat"
+    " pse36 clflush dts acpi mmx fxsr sse sse2 ss ht tm pbe syscall nx pdpe1gb"
+    " rdtscp lm constant_tsc art arch_perfmon pebs bts rep_good nopl xtopology"
+    " nonstop_tsc cpuid aperfmperf tsc_known_freq pni pclmulqdq dtes64 monitor"
+    " ds_cpl vmx smx est tm2 ssse3 sdbg fma cx16 xtpr pdcm pcid dca sse4_1"
+    " sse4_2 x2apic movbe popcnt tsc_deadline_timer aes xsave avx f16c rdrand"
+    " lahf_lm abm 3dnowprefetch avx512f avx512dq rdseed adx smap avx512ifma"
+    " clflushopt clwb avx512cd sha_ni avx512bw avx512vl amx_bf16 amx_tile"
+    " amx_int8\n"
+    "bugs\t\t: spectre_v1 spectre_v2 spec_store_bypass swapgs eibrs_pbrsb\n"
+    "bogomips\t: 4000.00\n"
+    "clflush size\t: 64\n"
+    "cache_alignment\t: 64\n"
+    "address sizes\t: 46 bits physical, 57 bits virtual\n"
+    "power management:\n";
+
+struct host {
+    unsigned int        cpus;
+    unsigned int        mounts;
+};
+
+struct result {
+    double              p50;
+    double              p90;
+    double              p99;
+    double              max;
+    double              publish;
+    double              read;
+    double              syscalls;
+    double              update_allocs;
+    double              publish_allocs;
+    long                heap;
+    unsigned long       entries;
+    unsigned long       bytes;
+};
+
+#ifdef HAVE_DIAGNOSTIC_MSGS
+const char publisher_kind[] = "StatusValues into diagnostic_msgs/DiagnosticArray";
+
+class Publisher : public sysmon::Sink {
+    /*
+     * The diagnostic publisher of the node less the topic.  By default each
+     * task keeps a diagnostic_msgs/DiagnosticStatus from one cycle to the
+     * next, written through StatusValues, and commit() copies them into one
+     * DiagnosticArray as DiagnosticPublisher::update() does.  With fresh set
+     * a new status is built every cycle with the values formatted through an
+     * ostringstream and copied into a new array, as diagnostic_updater does.
+     * The bytes are the serialized length of the array.
+     */
+    public:
+        Publisher(bool fresh) : m_fresh(fresh), m_entries(0), m_bytes(0) {}
+
+        using Sink::add;
+        void add(const std::string &name, const std::string &key, double value)
+        {
+            std::map<std::string, task>::iterator it = m_tasks.find(name);
+            if (it == m_tasks.end()) {
+                it = m_tasks.insert(std::make_pair(name, task())).first;
+                (*it).second.status.name = name;
+                (*it).second.status.message = "OK";
+            }
+            task &st = (*it).second;
+
+            if (m_fresh) {
+                std::ostringstream s;
+                s << value;
+                diagnostic_msgs::KeyValue kv;
+                kv.key = key;
+                kv.value = s.str();
+                st.status.values.push_back(kv);
+                return;
+            }
+
+            /* Collectors may interleave tasks, so a writer stays open per task */
+            if (!st.values)
+                st.values = new (st.storage.bytes) sysmon::StatusValues(st.status);
+            st.values->add(key, value);
+        }
+
+        int commit()
+        {
+            if (m_fresh) {
+                diagnostic_msgs::DiagnosticArray array;
+                for (std::map<std::string, task>::const_iterator it = m_tasks.begin(); it != m_tasks.end(); ++it)
+                    array.status.push_back((*it).second.status);
+                count(array);
+                m_tasks.clear();
+                return 0;
+            }
+
+            m_array.status.resize(m_tasks.size());
+            std::vector<diagnostic_msgs::DiagnosticStatus>::iterator dest = m_array.status.begin();
+            for (std::map<std::string, task>::iterator it = m_tasks.begin(); it != m_tasks.end(); ++it) {
+                task &st = (*it).second;
+                if (st.values) {
+                    st.values->~StatusValues();
+                    st.values = 0;
+                } else {
+                    st.status.values.clear();
+                }
+                *dest++ = st.status;
+            }
+            count(m_array);
+            return 0;
+        }
+
+        unsigned long entries() const { return m_entries; }
+        unsigned long bytes() const { return m_bytes; }
+
+    private:
+        struct task {
+            task() : values(0) {}
+
+            diagnostic_msgs::DiagnosticStatus status;
+            sysmon::StatusValues *values;
+            union {
+                char            bytes[sizeof(sysmon::StatusValues)];
+                void           *align;
+            } storage;
+        };
+
+        void count(const diagnostic_msgs::DiagnosticArray &array)
+        {
+            m_bytes = ros::serialization::serializationLength(array);
+            m_entries = 0;
+            for (unsigned int i = 0; i < array.status.size(); ++i)
+                m_entries += array.status[i].values.size();
+        }
+
+        bool                m_fresh;
+        std::map<std::string, task> m_tasks;
+        diagnostic_msgs::DiagnosticArray m_array;
+        unsigned long       m_entries;
+        unsigned long       m_bytes;
+};
+#else
+const char publisher_kind[] = "a model of StatusValues and diagnostic_msgs (built without ROS)";
+
+class Publisher : public sysmon::Sink {
+    /*
+     * Model of the diagnostic publisher of the node for builds without the
+     * diagnostic_msgs headers, commit() estimates the size the
+     * diagnostic_msgs/DiagnosticArray would be serialized to.
+     *
+     * By default each task keeps its status from one cycle to the next and
+     * the values are formatted over the last ones with format_value(), as
+     * DiagnosticPublisher and StatusValues do.  With fresh set a new status
+     * is built every cycle with the values formatted through an
+     * ostringstream and copied into a new array, as diagnostic_updater
+     * does.
+     */
+    public:
+        Publisher(bool fresh) : m_fresh(fresh), m_entries(0), m_bytes(0) {}
+
+        using Sink::add;
+        void add(const std::string &task, const std::string &key, double value)
+        {
+            status &st = m_statuses[task];
+
+            if (m_fresh) {
+                std::ostringstream s;
+                s << value;
+                st.values.push_back(std::make_pair(key, s.str()));
+                return;
+            }
+
+            if (st.next == st.values.size())
+                st.values.resize(st.next + 1);
+
+            std::pair<std::string, std::string> &kv = st.values[st.next++];
+            if (kv.first != key)
+                kv.first = key;
+            sysmon::format_value(kv.second, value);
+        }
+
+        int commit()
+        {
+            /* Header (seq, stamp, frame_id) and the status array length */
+            m_bytes = 4 + 8 + 4 + 4;
+            m_entries = 0;
+
+            if (m_fresh) {
+                std::vector<keyvalues> array;
+                for (std::map<std::string, status>::const_iterator it = m_statuses.begin(); it != m_statuses.end(); ++it)
+                    array.push_back((*it).second.values);
+                count(array);
+                m_statuses.clear();
+                return 0;
+            }
+
+            m_array.resize(m_statuses.size());
+            std::vector<keyvalues>::iterator dest = m_array.begin();
+            for (std::map<std::string, status>::iterator it = m_statuses.begin(); it != m_statuses.end(); ++it) {
+                status &st = (*it).second;
+                st.values.resize(st.next);
+                st.next = 0;
+                *dest++ = st.values;
+            }
+            count(m_array);
+            return 0;
+        }
+
+        unsigned long entries() const { return m_entries; }
+        unsigned long bytes() const { return m_bytes; }
+
+    private:
+        typedef std::vector<std::pair<std::string, std::string> > keyvalues;
+
+        struct status {
+            status() : next(0) {}
+
+            keyvalues           values;
+            size_t              next;
+        };
+
+        void count(const std::vector<keyvalues> &array)
+        {
+            std::map<std::string, status>::const_iterator it = m_statuses.begin();
+            for (std::vector<keyvalues>::const_iterator st = array.begin(); st != array.end(); ++st, ++it) {
+                /* level, name, message "OK", hardware_id and values length */
+                m_bytes += 1 + 4 + (*it).first.size() + 4 + 2 + 4 + 16 + 4;
+
+                for (keyvalues::const_iterator v = (*st).begin(); v != (*st).end(); ++v)
+                    m_bytes += 4 + (*v).first.size() + 4 + (*v).second.size();
+                m_entries += (*st).size();
+            }
+        }
+
+        bool                m_fresh;
+        std::map<std::string, status> m_statuses;
+        std::vector<keyvalues> m_array;
+        unsigned long       m_entries;
+        unsigned long       m_bytes;
+};
+
+#endif
+
+void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [-c cpus] [-m mounts] [-n cycles] [-l limit] [-f] [-u] [-z]\n"
+            "\n"
+            "  -c cpus     Comma separated cpu counts to simulate (4,64,256)\n"
+            "  -m mounts   Comma separated mount counts to simulate (8,100,500)\n"
+            "  -n cycles   Cycles to time per host (200)\n"
+            "  -l limit    Fail if the 99th percentile cycle takes longer than\n"
+            "              limit microseconds on any host\n"
+            "  -f          Build a fresh status every cycle, as diagnostic_updater\n"
+            "              does, instead of reusing the last one\n"
+            "  -u          Read the files through io_uring instead of pread()\n"
+            "  -z          Fail if the collectors allocate once warmed up\n"
+            "\n"
+            "One line is printed per host with the cycle time percentiles in\n"
+            "microseconds, the median time taken to read the files and to\n"
+            "publish, the system calls made a cycle reading, the allocations\n"
+            "made a cycle updating the collectors and publishing, the heap held\n"
+            "by the collectors and the number of values and bytes published each\n"
+            "cycle.  Values are published through %s.\n",
+            argv0, publisher_kind);
+}
+
+std::vector<unsigned int> parse_list(const char *s)
+{
+    std::vector<unsigned int> ret;
+    char *end;
+
+    for (;;) {
+        unsigned long v = strtoul(s, &end, 10);
+        if (end == s)
+            break;
+        ret.push_back(v);
+        if (*end != ',')
+            break;
+        s = end + 1;
+    }
+
+    return ret;
+}
+
+int write_file(const std::string &path, const std::string &contents)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return errno;
+
+    ssize_t n = write(fd, contents.data(), contents.size());
+    int r = n < 0 ? errno : (n != (ssize_t)contents.size() ? EIO : 0);
+    close(fd);
+
+    return r;
+}
+
+/*
+ * Write /proc/stat as it would read after cycle seconds of load.  The file
+ * is rewritten in place so the descriptor FileSet holds stays valid.
+ */
+int write_stat(const std::string &root, const host &h, unsigned int cycle)
+{
+    std::ostringstream s;
+    unsigned long long t = 100000 + cycle * 100ULL;
+
+    s << "cpu  " << t * h.cpus / 4 << " 0 " << t * h.cpus / 8 << " " << t * h.cpus / 2
+        << " 100 0 20 0 0 0\n";
+    for (unsigned int i = 0; i < h.cpus; ++i) {
+        unsigned long long busy = (t * (i % 5 + 1)) / 10;
+        s << "cpu" << i << " " << busy << " 0 " << busy / 2 << " " << t - busy - busy / 2
+            << " 1 0 " << i << " 0 0 0\n";
+    }
+    s << "intr " << cycle * 1000ULL * h.cpus << "\n"
+        << "ctxt " << cycle * 5000ULL * h.cpus << "\n"
+        << "btime 1700000000\n"
+        << "processes " << cycle * 10 << "\n"
+        << "procs_running " << h.cpus / 4 + 1 << "\n"
+        << "procs_blocked 0\n"
+        << "softirq 0 0 0 0 0 0 0 0 0 0 0\n";
+
+    return write_file(root + "/proc/stat", s.str());
+}
+
+/*
+ * Write /proc/interrupts and /proc/softirqs with a column per cpu.  Besides
+ * the legacy and named interrupts there is a queue interrupt per pair of
+ * cpus, as many-queue NVMe drives have.  Like /proc/stat both are rewritten
+ * in place each cycle.
+ */
+int write_interrupts(const std::string &root, const host &h, unsigned int cycle)
+{
+    static const char *named[][2] = {
+        { "NMI", "Non-maskable interrupts" },
+        { "LOC", "Local timer interrupts" },
+        { "SPU", "Spurious interrupts" },
+        { "PMI", "Performance monitoring interrupts" },
+        { "IWI", "IRQ work interrupts" },
+        { "RES", "Rescheduling interrupts" },
+        { "CAL", "Function call interrupts" },
+        { "TLB", "TLB shootdowns" },
+        { "MCE", "Machine check exceptions" },
+        { "MCP", "Machine check polls" },
+    };
+    static const char *softirqs[] = {
+        "HI", "TIMER", "NET_TX", "NET_RX", "BLOCK", "IRQ_POLL", "TASKLET",
+        "SCHED", "HRTIMER", "RCU",
+    };
+    const unsigned int legacy = 16;
+    const unsigned int queues = h.cpus / 2;
+    char buf[64];
+
+    std::string irqs;
+    irqs.append("           ");
+    for (unsigned int i = 0; i < h.cpus; ++i) {
+        snprintf(buf, sizeof(buf), "CPU%-8u", i);
+        irqs.append(buf);
+    }
+    irqs.append("\n");
+
+    for (unsigned int row = 0; row < legacy + queues + sizeof(named) / sizeof(named[0]); ++row) {
+        if (row < legacy + queues)
+            snprintf(buf, sizeof(buf), "%4u:", row < legacy ? row : 24 + row);
+        else
+            snprintf(buf, sizeof(buf), " %s:", named[row - legacy - queues][0]);
+        irqs.append(buf);
+
+        for (unsigned int i = 0; i < h.cpus; ++i) {
+            snprintf(buf, sizeof(buf), " %10llu", cycle * 10ULL * ((row + i) % 7 + 1));
+            irqs.append(buf);
+        }
+
+        if (row < legacy) {
+            snprintf(buf, sizeof(buf), "  IR-IO-APIC   %u-edge      legacy%u", row, row);
+        } else if (row < legacy + queues) {
+            unsigned int q = row - legacy;
+            snprintf(buf, sizeof(buf), "  IR-PCI-MSI %u-edge      nvme%uq%u", 524288 + q, q / 64, q % 64 + 1);
+        } else {
+            snprintf(buf, sizeof(buf), "   %s", named[row - legacy - queues][1]);
+        }
+        irqs.append(buf);
+        irqs.append("\n");
+    }
+    snprintf(buf, sizeof(buf), " ERR: %10u\n MIS: %10u\n", 0, 0);
+    irqs.append(buf);
+
+    std::string soft;
+    soft.append("                    ");
+    for (unsigned int i = 0; i < h.cpus; ++i) {
+        snprintf(buf, sizeof(buf), "CPU%-8u", i);
+        soft.append(buf);
+    }
+    soft.append("\n");
+
+    for (unsigned int row = 0; row < sizeof(softirqs) / sizeof(softirqs[0]); ++row) {
+        snprintf(buf, sizeof(buf), "%12s:", softirqs[row]);
+        soft.append(buf);
+        for (unsigned int i = 0; i < h.cpus; ++i) {
+            snprintf(buf, sizeof(buf), " %10llu", cycle * 100ULL * ((row + i) % 5 + 1));
+            soft.append(buf);
+        }
+        soft.append("\n");
+    }
+
+    int r;
+    if ((r = write_file(root + "/proc/interrupts", irqs))
+            || (r = write_file(root + "/proc/softirqs", soft)))
+        return r;
+
+    return 0;
+}
+
+int make_tree(const std::string &root, const host &h)
+{
+    int r;
+
+    if (mkdir((root + "/proc").c_str(), 0755)
+            || mkdir((root + "/etc").c_str(), 0755)
+            || mkdir((root + "/mnt").c_str(), 0755))
+        return errno;
+
+    std::ostringstream info;
+    for (unsigned int i = 0; i < h.cpus; ++i) {
+        info << "processor\t: " << i << "\n"
+            << "physical id\t: " << i / 64 << "\n"
+            << "core id\t\t: " << i % 64 << "\n"
+            << cpuinfo << "\n";
+    }
+
+    std::ostringstream loadavg;
+    loadavg << h.cpus / 2 << ".50 " << h.cpus / 2 << ".25 " << h.cpus / 2 << ".00 1/"
+        << h.cpus * 20 << " 12345\n";
+
+    /* Pseudo filesystems are skipped by DiskUsage but still parsed */
+    std::ostringstream mtab;
+    mtab << "proc /proc proc rw,nosuid,nodev,noexec,relatime 0 0\n"
+        << "sysfs /sys sysfs rw,nosuid,nodev,noexec,relatime 0 0\n"
+        << "tmpfs /run tmpfs rw,nosuid,nodev,mode=755 0 0\n"
+        << "cgroup /sys/fs/cgroup/cpu cgroup rw,nosuid,nodev,noexec,relatime,cpu 0 0\n";
+    for (unsigned int i = 0; i < h.mounts; ++i) {
+        std::ostringstream dir;
+        dir << "/mnt/disk" << i;
+        if (mkdir((root + dir.str()).c_str(), 0755))
+            return errno;
+        mtab << "/dev/nvme" << i / 16 << "n1p" << i % 16 + 1 << " " << dir.str()
+            << " ext4 rw,noatime 0 0\n";
+    }
+
+    if ((r = write_file(root + "/proc/cpuinfo", info.str()))
+            || (r = write_file(root + "/proc/meminfo", meminfo))
+            || (r = write_file(root + "/proc/loadavg", loadavg.str()))
+            || (r = write_file(root + "/etc/mtab", mtab.str()))
+            || (r = write_stat(root, h, 0))
+            || (r = write_interrupts(root, h, 0)))
+        return r;
+
+    return 0;
+}
+
+int remove_entry(const char *path, const struct stat *, int, struct FTW *)
+{
+    return remove(path);
+}
+
+long heap_in_use()
+{
+#if __GLIBC_PREREQ(2, 33)
+    return mallinfo2().uordblks;
+#else
+    return mallinfo().uordblks;
+#endif
+}
+
+double percentile(std::vector<double> &v, double p)
+{
+    std::vector<double>::iterator it = v.begin() + (size_t)(p * (v.size() - 1));
+    std::nth_element(v.begin(), it, v.end());
+    return *it;
+}
+
+/*
+ * Run the sample cycle of the sysmon node against a synthetic host.
+ */
+int measure(const std::string &root, const host &h, unsigned int cycles, bool fresh, bool uring,
+        result &res)
+{
+    int r = make_tree(root, h);
+    if (r)
+        return r;
+
+    long heap = heap_in_use();
+    std::vector<double> times;
+    std::vector<double> publish;
+    std::vector<double> reads;
+    unsigned long syscalls = 0;
+    unsigned long update_allocs = 0;
+    unsigned long publish_allocs = 0;
+    times.reserve(cycles);
+    publish.reserve(cycles);
+    reads.reserve(cycles);
+
+    {
+        sysmon::FileSet files(uring, root);
+        if (uring && !files.uring())
+            return ENOSYS;
+
+        sysmon::CpuInfo cpuinfo(files);
+        sysmon::LoadAvg loadavg(files);
+        sysmon::MemInfo meminfo(files);
+        sysmon::Power power(files);
+        sysmon::CpuTime cputime(files);
+        sysmon::DiskUsage diskusage(files, std::set<std::string>());
+        sysmon::Interrupts interrupts(files, "/proc/interrupts", "Interrupts");
+        sysmon::Interrupts softirqs(files, "/proc/softirqs", "Softirqs");
+        Publisher publisher(fresh);
+
+        for (unsigned int i = 0; i < warmup + cycles; ++i) {
+            if ((r = write_stat(root, h, i + 1))
+                    || (r = write_interrupts(root, h, i + 1)))
+                return r;
+
+            double start = sysmon::monotonic_seconds();
+            unsigned long started = allocations;
+
+            files.read();
+            cpuinfo.update();
+            cputime.update();
+            loadavg.update();
+            meminfo.update();
+            diskusage.update();
+            interrupts.update();
+            softirqs.update();
+            power.update();
+
+            double recorded = sysmon::monotonic_seconds();
+            unsigned long allocated = allocations;
+
+            cputime.record(publisher);
+            loadavg.record(publisher);
+            meminfo.record(publisher);
+            diskusage.record(publisher);
+            interrupts.record(publisher);
+            softirqs.record(publisher);
+            power.record(publisher);
+            publisher.commit();
+
+            if (i >= warmup) {
+                double now = sysmon::monotonic_seconds();
+                times.push_back(now - start);
+                publish.push_back(now - recorded);
+                reads.push_back(files.read_time());
+                syscalls += files.syscalls();
+                update_allocs += allocated - started;
+                publish_allocs += allocations - allocated;
+            }
+        }
+
+        res.heap = heap_in_use() - heap;
+        res.entries = publisher.entries();
+        res.bytes = publisher.bytes();
+    }
+
+    res.p50 = percentile(times, 0.50) * 1e6;
+    res.p90 = percentile(times, 0.90) * 1e6;
+    res.p99 = percentile(times, 0.99) * 1e6;
+    res.max = *std::max_element(times.begin(), times.end()) * 1e6;
+    res.publish = percentile(publish, 0.50) * 1e6;
+    res.read = percentile(reads, 0.50) * 1e6;
+    res.syscalls = (double)syscalls / cycles;
+    res.update_allocs = (double)update_allocs / cycles;
+    res.publish_allocs = (double)publish_allocs / cycles;
+
+    return 0;
+}
+
+} // namespace
+
+/*
+ * Count allocations so the cost of publishing can be told apart from the
+ * size of the published message.
+ */
+void *operator new(size_t size) NEW_THROW
+{
+    ++allocations;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size) NEW_THROW
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) throw()
+{
+    free(p);
+}
+
+void operator delete[](void *p) throw()
+{
+    free(p);
+}
+
+#ifdef __cpp_sized_deallocation
+/* Sized deallocation is used when available, it must free what new returned */
+void operator delete(void *p, size_t) throw()
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) throw()
+{
+    free(p);
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    std::vector<unsigned int> cpus;
+    std::vector<unsigned int> mounts;
+    unsigned int cycles = 200;
+    double limit = 0;
+    bool fresh = false;
+    bool uring = false;
+    bool no_allocs = false;
+    int c;
+
+    while ((c = getopt(argc, argv, "c:m:n:l:fuzh")) != -1) {
+        switch (c) {
+            case 'c':
+                cpus = parse_list(optarg);
+                break;
+            case 'm':
+                mounts = parse_list(optarg);
+                break;
+            case 'n':
+                cycles = strtoul(optarg, NULL, 10);
+                break;
+            case 'l':
+                limit = strtod(optarg, NULL);
+                break;
+            case 'f':
+                fresh = true;
+                break;
+            case 'u':
+                uring = true;
+                break;
+            case 'z':
+                no_allocs = true;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind != argc || !cycles) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (cpus.empty()) {
+        cpus.push_back(4);
+        cpus.push_back(64);
+        cpus.push_back(256);
+    }
+    if (mounts.empty()) {
+        mounts.push_back(8);
+        mounts.push_back(100);
+        mounts.push_back(500);
+    }
+
+    printf("Reading with %s, publishing through %s\n", uring ? "io_uring" : "pread()", publisher_kind);
+    printf("%6s %6s %9s %9s %9s %9s %9s %9s %8s %10s %10s %9s %8s %9s\n",
+            "cpus", "mounts", "p50 us", "p90 us", "p99 us", "max us", "read us", "pub us", "syscalls",
+            "upd allocs", "pub allocs", "heap KiB", "values", "bytes");
+
+    int ret = 0;
+    for (std::vector<unsigned int>::const_iterator cpu = cpus.begin(); cpu != cpus.end(); ++cpu) {
+        for (std::vector<unsigned int>::const_iterator mount = mounts.begin(); mount != mounts.end(); ++mount) {
+            host h = { *cpu, *mount };
+            result res = result();
+            char root[] = "/tmp/sysmon_scale.XXXXXX";
+
+            if (!mkdtemp(root)) {
+                fprintf(stderr, "%s: mkdtemp: %s\n", argv[0], strerror(errno));
+                return 1;
+            }
+
+            int r = measure(root, h, cycles, fresh, uring, res);
+            nftw(root, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+            if (r) {
+                fprintf(stderr, "%s: %u cpus, %u mounts: %s\n", argv[0], h.cpus, h.mounts, strerror(r));
+                return 1;
+            }
+
+            printf("%6u %6u %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %8.1f %10.1f %10.1f %9ld %8lu %9lu\n",
+                    h.cpus, h.mounts, res.p50, res.p90, res.p99, res.max, res.read, res.publish,
+                    res.syscalls, res.update_allocs, res.publish_allocs, res.heap / 1024, res.entries, res.bytes);
+
+            if (limit > 0 && res.p99 > limit) {
+                fprintf(stderr, "%s: %u cpus, %u mounts: 99th percentile of %.1f us exceeds %.1f us\n",
+                        argv[0], h.cpus, h.mounts, res.p99, limit);
+                ret = 1;
+            }
+
+            if (no_allocs && res.update_allocs > 0) {
+                fprintf(stderr, "%s: %u cpus, %u mounts: the collectors allocate %.1f times a cycle\n",
+                        argv[0], h.cpus, h.mounts, res.update_allocs);
+                ret = 1;
+            }
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstdlib>
+#include <string>
+
+namespace sysmon {
+
+class Sink {
+    /*
+     * Consumer of typed samples.  After each cycle the collectors add the
+     * values of their last update, named by diagnostic task and key, and the
+     * sink is then committed.
+     */
+    public:
+        virtual ~Sink() {}
+
+        /*
+         * Add a sample to the current cycle.
+         */
+        virtual void add(const std::string &task, const std::string &key, double value) = 0;
+
+        /*
+         * Add a sample kept as a string by a collector.  It is only added if
+         * it starts with a number, units following it are ignored.
+         */
+        void add(const std::string &task, const std::string &key, const std::string &value)
+        {
+            const char *s = value.c_str();
+            char *end;
+
+            double v = strtod(s, &end);
+            if (end != s)
+                add(task, key, v);
+        }
+
+        /*
+         * Finish the current cycle.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        virtual int commit() = 0;
+};
+
+} // namespace sysmon
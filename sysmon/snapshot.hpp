@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+/*
+ * Latest sample published by sysmon in POSIX shared memory (see
+ * ~shm/name).  This header has no dependencies beyond libc/librt so it may
+ * be included by any local process:
+ *
+ *     sysmon::SnapshotReader reader;
+ *     sysmon::snapshot s;
+ *
+ *     if (!reader.open("/sysmon") && !reader.read(s))
+ *         printf("cpu %.1f%%, %.0f kB available\n", s.cpu_usage, s.mem_available);
+ *
+ * The segment is guarded by a seqlock.  sysmon bumps the sequence to an odd
+ * value, copies in the new snapshot and bumps it again, a reader copies the
+ * snapshot out and retries if the sequence was odd or changed meanwhile.
+ * Reading costs a copy of the structure and no system calls.
+ *
+ * The segment is left in place when sysmon exits, compare snapshot::time
+ * against the current time to detect a stale snapshot.  Fields are only ever
+ * appended, SNAPSHOT_VERSION changes if the meaning of an existing one does.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace sysmon {
+
+static const char       SNAPSHOT_MAGIC[8] = { 'S', 'Y', 'S', 'M', 'O', 'N', 'S', 'S' };
+static const uint32_t   SNAPSHOT_VERSION = 1;
+static const unsigned   SNAPSHOT_MAX_CPUS = 256;
+static const unsigned   SNAPSHOT_MAX_DISKS = 16;
+
+struct snapshot {
+    int64_t     time;               /* Milliseconds since the epoch */
+    uint32_t    nproc;              /* Valid entries in cpu */
+    uint32_t    ndisks;             /* Valid entries in disk */
+
+    double      load[3];            /* 1, 5 and 15 minute load average */
+
+    double      cpu_usage;          /* % busy across all cpus since the last sample */
+    double      cpu_iowait;         /* % waiting on io across all cpus */
+    double      cpu[SNAPSHOT_MAX_CPUS];    /* % busy per cpu */
+
+    double      ctxt_rate;          /* Context switches per second */
+    double      fork_rate;          /* Forks per second */
+    double      intr_rate;          /* Interrupts per second */
+    double      procs_running;
+    double      procs_blocked;
+
+    /* kB, zero if excluded by ~meminfo/whitelist */
+    double      mem_total;
+    double      mem_free;
+    double      mem_available;
+    double      mem_cached;
+    double      swap_total;
+    double      swap_free;
+
+    struct {
+        char    mount[64];
+        double  size;               /* kB */
+        double  avail;              /* kB */
+        double  usage;              /* % */
+    } disk[SNAPSHOT_MAX_DISKS];
+};
+
+struct snapshot_segment {
+    char                magic[8];
+    uint32_t            version;
+    uint32_t            size;       /* sizeof(snapshot) of the writer */
+    volatile uint32_t   seq;
+    uint8_t             pad[44];
+    snapshot            data;
+};
+
+class SnapshotReader {
+    public:
+        SnapshotReader() :
+            m_seg(NULL)
+        {}
+
+        ~SnapshotReader()
+        {
+            close();
+        }
+
+        /*
+         * Map the segment published by sysmon.
+         *
+         * @param name  - Shared memory object name, ~shm/name of sysmon.
+         *
+         * @return      - 0 on success, appropriate errno otherwise.
+         */
+        int open(const char *name)
+        {
+            close();
+
+            int fd = shm_open(name, O_RDONLY, 0);
+            if (fd < 0)
+                return errno;
+
+            struct stat st;
+            if (fstat(fd, &st) || (size_t)st.st_size < sizeof(snapshot_segment)) {
+                ::close(fd);
+                return EINVAL;
+            }
+
+            void *p = mmap(NULL, sizeof(snapshot_segment), PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (p == MAP_FAILED)
+                return errno;
+
+            const snapshot_segment *seg = static_cast<const snapshot_segment *>(p);
+            if (memcmp(seg->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC))
+                    || seg->version != SNAPSHOT_VERSION
+                    || seg->size < sizeof(snapshot)) {
+                munmap(p, sizeof(snapshot_segment));
+                return EPROTO;
+            }
+
+            m_seg = seg;
+            return 0;
+        }
+
+        void close()
+        {
+            if (m_seg)
+                munmap(const_cast<snapshot_segment *>(m_seg), sizeof(snapshot_segment));
+            m_seg = NULL;
+        }
+
+        /*
+         * Copy out the latest snapshot.
+         *
+         * @return  - 0 on success, EAGAIN if a consistent copy could not be
+         *            taken, EBADF if not open.
+         */
+        int read(snapshot &out) const
+        {
+            if (!m_seg)
+                return EBADF;
+
+            /* sysmon only holds the lock for a memcpy, so this rarely loops */
+            for (unsigned int i = 0; i < 1000; ++i) {
+                uint32_t seq = m_seg->seq;
+                __sync_synchronize();
+
+                if (seq & 1)
+                    continue;
+
+                memcpy(&out, const_cast<const snapshot *>(&m_seg->data), sizeof(out));
+                __sync_synchronize();
+
+                if (m_seg->seq == seq)
+                    return 0;
+            }
+            return EAGAIN;
+        }
+
+    private:
+        SnapshotReader(const SnapshotReader &);
+        SnapshotReader & operator=(const SnapshotReader &);
+
+        const snapshot_segment *m_seg;
+};
+
+} // namespace sysmon
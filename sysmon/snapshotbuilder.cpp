@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+
+#include "snapshotbuilder.hpp"
+
+namespace sysmon {
+
+namespace {
+
+const char CPU_TOTAL[] = "CPU Time - Total";
+const char CPU_PREFIX[] = "Cpu Time - Processor ";
+const char DISK_PREFIX[] = "Disk Usage - ";
+
+bool starts_with(const std::string &s, const char *prefix, size_t len)
+{
+    return !s.compare(0, len, prefix);
+}
+
+/*
+ * Store one of the cpu time counters usage is derived from.
+ */
+void set_counter(double &total, double &idle, double &iowait,
+        const std::string &key, double value)
+{
+    if (key == "total")
+        total = value;
+    else if (key == "idle")
+        idle = value;
+    else if (key == "iowait")
+        iowait = value;
+}
+
+} // namespace
+
+SnapshotBuilder::SnapshotBuilder()
+{
+    memset(&m_next, 0, sizeof(m_next));
+    memset(&m_current, 0, sizeof(m_current));
+    memset(&m_total, 0, sizeof(m_total));
+}
+
+void SnapshotBuilder::add(const std::string &task, const std::string &key, double value)
+{
+    if (task == CPU_TOTAL) {
+        if (key == "context switches/s")
+            m_next.ctxt_rate = value;
+        else if (key == "forks/s")
+            m_next.fork_rate = value;
+        else if (key == "interrupts/s")
+            m_next.intr_rate = value;
+        else if (key == "procs_running")
+            m_next.procs_running = value;
+        else if (key == "procs_blocked")
+            m_next.procs_blocked = value;
+        else
+            set_counter(m_total.total, m_total.idle, m_total.iowait, key, value);
+    } else if (starts_with(task, CPU_PREFIX, sizeof(CPU_PREFIX) - 1)) {
+        unsigned long cpu = strtoul(task.c_str() + sizeof(CPU_PREFIX) - 1, NULL, 10);
+        if (cpu >= SNAPSHOT_MAX_CPUS)
+            return;
+
+        if (cpu >= m_cpus.size()) {
+            cpu_counters zero;
+            memset(&zero, 0, sizeof(zero));
+            m_cpus.resize(cpu + 1, zero);
+        }
+        set_counter(m_cpus[cpu].total, m_cpus[cpu].idle, m_cpus[cpu].iowait, key, value);
+    } else if (task == "Memory") {
+        static const struct {
+            const char *    key;
+            double snapshot::*dest;
+        } keys[] = {
+            { "MemTotal",       &snapshot::mem_total },
+            { "MemFree",        &snapshot::mem_free },
+            { "MemAvailable",   &snapshot::mem_available },
+            { "Cached",         &snapshot::mem_cached },
+            { "SwapTotal",      &snapshot::swap_total },
+            { "SwapFree",       &snapshot::swap_free },
+        };
+
+        for (unsigned int i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+            if (key == keys[i].key) {
+                m_next.*keys[i].dest = value;
+                return;
+            }
+        }
+    } else if (task == "Load Average") {
+        if (key == "1 minute")
+            m_next.load[0] = value;
+        else if (key == "5 minute")
+            m_next.load[1] = value;
+        else if (key == "15 minute")
+            m_next.load[2] = value;
+    } else if (starts_with(task, DISK_PREFIX, sizeof(DISK_PREFIX) - 1)) {
+        m_mount.assign(task, sizeof(DISK_PREFIX) - 1, std::string::npos);
+        std::map<std::string, unsigned int>::iterator it = m_disks.find(m_mount);
+
+        if (it == m_disks.end()) {
+            if (m_disks.size() >= SNAPSHOT_MAX_DISKS)
+                return;
+            it = m_disks.insert(std::make_pair(m_mount, m_disks.size())).first;
+            strncpy(m_next.disk[(*it).second].mount, m_mount.c_str(), sizeof(m_next.disk[0].mount) - 1);
+        }
+
+        if (key == "size")
+            m_next.disk[(*it).second].size = value;
+        else if (key == "avail")
+            m_next.disk[(*it).second].avail = value;
+        else if (key == "usage")
+            m_next.disk[(*it).second].usage = value;
+    }
+}
+
+int SnapshotBuilder::commit()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    m_next.time = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+    m_next.cpu_usage = busy(m_total);
+    m_next.cpu_iowait = iowait(m_total);
+    m_total.last_total = m_total.total;
+    m_total.last_idle = m_total.idle;
+    m_total.last_iowait = m_total.iowait;
+
+    m_next.nproc = m_cpus.size();
+    for (unsigned int i = 0; i < m_cpus.size(); ++i) {
+        m_next.cpu[i] = busy(m_cpus[i]);
+        m_cpus[i].last_total = m_cpus[i].total;
+        m_cpus[i].last_idle = m_cpus[i].idle;
+        m_cpus[i].last_iowait = m_cpus[i].iowait;
+    }
+
+    m_next.ndisks = m_disks.size();
+    m_current = m_next;
+
+    return 0;
+}
+
+const snapshot & SnapshotBuilder::get() const
+{
+    return m_current;
+}
+
+double SnapshotBuilder::busy(const cpu_counters &c)
+{
+    double total = c.total - c.last_total;
+    double idle = (c.idle - c.last_idle) + (c.iowait - c.last_iowait);
+
+    if (!c.last_total || total <= 0)
+        return 0;
+    return 100 * (total - idle) / total;
+}
+
+double SnapshotBuilder::iowait(const cpu_counters &c)
+{
+    double total = c.total - c.last_total;
+
+    if (!c.last_total || total <= 0)
+        return 0;
+    return 100 * (c.iowait - c.last_iowait) / total;
+}
+
+} // namespace sysmon
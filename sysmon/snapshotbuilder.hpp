@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "sink.hpp"
+#include "snapshot.hpp"
+
+namespace sysmon {
+
+class SnapshotBuilder : public Sink {
+    /*
+     * Builds a typed snapshot out of the samples added by the collectors,
+     * see snapshot.hpp for the fields.  Cpu usage is derived from the cpu
+     * time counters of consecutive cycles.
+     */
+    public:
+        /*
+         * Constructor
+         */
+        SnapshotBuilder();
+
+        using Sink::add;
+        void add(const std::string &task, const std::string &key, double value);
+
+        /*
+         * Finish the snapshot of the samples added since the last commit.
+         */
+        int commit();
+
+        /*
+         * Get the snapshot as of the last commit.
+         */
+        const snapshot & get() const;
+
+    private:
+        struct cpu_counters {
+            double              total;
+            double              idle;
+            double              iowait;
+            double              last_total;
+            double              last_idle;
+            double              last_iowait;
+        };
+
+        /*
+         * Turn the cpu time counters into % of the time since the last cycle.
+         */
+        static double busy(const cpu_counters &c);
+        static double iowait(const cpu_counters &c);
+
+        snapshot                    m_next;
+        snapshot                    m_current;
+
+        cpu_counters                m_total;
+        std::vector<cpu_counters>   m_cpus;
+        std::map<std::string, unsigned int> m_disks;
+        std::string                 m_mount;
+};
+
+} // namespace sysmon
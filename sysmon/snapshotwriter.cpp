@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <ros/ros.h>
+
+#include "snapshotwriter.hpp"
+
+namespace sysmon {
+
+SnapshotWriter::SnapshotWriter() :
+    m_seg(NULL)
+{
+    std::string name;
+
+    if (!ros::param::get("~shm/name", name) || name.empty())
+        return;
+
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        ROS_ERROR("%s:  Failed to open %s, errno %d", __func__, name.c_str(), errno);
+        return;
+    }
+
+    if (ftruncate(fd, sizeof(snapshot_segment))) {
+        ROS_ERROR("%s:  Failed to size %s, errno %d", __func__, name.c_str(), errno);
+        close(fd);
+        return;
+    }
+
+    void *p = mmap(NULL, sizeof(snapshot_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        ROS_ERROR("%s:  Failed to map %s, errno %d", __func__, name.c_str(), errno);
+        return;
+    }
+
+    m_seg = static_cast<snapshot_segment *>(p);
+
+    /*
+     * Readers of a previous instance may still have the segment mapped, keep
+     * the sequence moving forward and even.
+     */
+    uint32_t seq = m_seg->seq;
+    m_seg->seq = seq + 1 + (seq & 1);
+    __sync_synchronize();
+    memset(&m_seg->data, 0, sizeof(m_seg->data));
+    m_seg->version = SNAPSHOT_VERSION;
+    m_seg->size = sizeof(snapshot);
+    memcpy(m_seg->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    __sync_synchronize();
+    m_seg->seq = m_seg->seq + 1;
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+    if (m_seg)
+        munmap(m_seg, sizeof(snapshot_segment));
+}
+
+bool SnapshotWriter::enabled() const
+{
+    return m_seg;
+}
+
+void SnapshotWriter::add(const std::string &task, const std::string &key, double value)
+{
+    m_builder.add(task, key, value);
+}
+
+int SnapshotWriter::commit()
+{
+    if (!m_seg)
+        return 0;
+
+    m_builder.commit();
+
+    m_seg->seq = m_seg->seq + 1;
+    __sync_synchronize();
+    memcpy(&m_seg->data, &m_builder.get(), sizeof(snapshot));
+    __sync_synchronize();
+    m_seg->seq = m_seg->seq + 1;
+
+    return 0;
+}
+
+} // namespace sysmon
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "sink.hpp"
+#include "snapshot.hpp"
+#include "snapshotbuilder.hpp"
+
+namespace sysmon {
+
+class SnapshotWriter : public Sink {
+    /*
+     * Publishes the latest sample of each cycle as a typed snapshot in POSIX
+     * shared memory for local processes, see snapshot.hpp for the layout and
+     * reader.  The snapshot is built by a SnapshotBuilder.
+     *
+     * ROS Parameters:
+     *
+     * ~/shm/name:  Name of the shared memory object, for example "/sysmon".
+     *              Publishing is disabled when unset.
+     */
+    public:
+        /*
+         * Constructor
+         */
+        SnapshotWriter();
+
+        ~SnapshotWriter();
+
+        /*
+         * Whether a segment is being published to.
+         */
+        bool enabled() const;
+
+        using Sink::add;
+        void add(const std::string &task, const std::string &key, double value);
+
+        /*
+         * Publish the snapshot built from the samples added since the last
+         * commit.
+         */
+        int commit();
+
+    private:
+        SnapshotWriter(const SnapshotWriter &);
+        SnapshotWriter & operator=(const SnapshotWriter &);
+
+        snapshot_segment *          m_seg;
+        SnapshotBuilder             m_builder;
+};
+
+} // namespace sysmon
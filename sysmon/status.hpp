@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <diagnostic_msgs/DiagnosticStatus.h>
+
+#include "format.hpp"
+
+namespace sysmon {
+
+class StatusValues {
+    /*
+     * Writes the values of a diagnostic status in place.  DiagnosticPublisher
+     * keeps each task's status from one update to the next, so while a task
+     * adds the same keys in the same order every update the keys are only
+     * compared and the values are formatted into the storage of the last
+     * ones.  Values left over from the previous update are dropped when the
+     * writer goes out of scope.  Only the diagnostic_msgs headers are needed,
+     * so sysmon_scale can time it without the rest of ROS.
+     *
+     *     StatusValues values(dsw);
+     *     values.add("forks/s", m_fork_rate);
+     */
+    public:
+        StatusValues(diagnostic_msgs::DiagnosticStatus &status) :
+            m_values(status.values),
+            m_next(0)
+        {}
+
+        ~StatusValues()
+        {
+            m_values.resize(m_next);
+        }
+
+        template <typename T>
+        void add(const std::string &key, const T &value)
+        {
+            format_value(slot(key.data(), key.size()), value);
+        }
+
+        template <typename T>
+        void add(const char *key, const T &value)
+        {
+            format_value(slot(key, strlen(key)), value);
+        }
+
+    private:
+        /*
+         * Value of the next slot, with its key set to key.
+         */
+        std::string & slot(const char *key, size_t len)
+        {
+            if (m_next == m_values.size())
+                m_values.resize(m_next + 1);
+
+            diagnostic_msgs::KeyValue &kv = m_values[m_next++];
+            if (kv.key.size() != len || memcmp(kv.key.data(), key, len))
+                kv.key.assign(key, len);
+
+            return kv.value;
+        }
+
+        StatusValues(const StatusValues &);
+        StatusValues & operator=(const StatusValues &);
+
+        diagnostic_msgs::DiagnosticStatus::_values_type & m_values;
+        size_t              m_next;
+};
+
+} // namespace sysmon
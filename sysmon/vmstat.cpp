@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include "clock.hpp"
+#include "parse.hpp"
+#include "status.hpp"
+#include "vmstat.hpp"
+
+namespace sysmon {
+
+namespace {
+
+struct vmstat_key {
+    const char *        name;
+    VmStat::counter     counter;
+};
+
+/*
+ * Lines of /proc/vmstat that are of interest, sorted by name so they can be
+ * binary searched.  Kernels since 4.10 split allocstall per zone, those are
+ * summed back into one counter.
+ */
+const vmstat_key keys[] = {
+    { "allocstall",         VmStat::ALLOCSTALL },
+    { "allocstall_dma",     VmStat::ALLOCSTALL },
+    { "allocstall_dma32",   VmStat::ALLOCSTALL },
+    { "allocstall_movable", VmStat::ALLOCSTALL },
+    { "allocstall_normal",  VmStat::ALLOCSTALL },
+    { "compact_fail",       VmStat::COMPACT_FAIL },
+    { "compact_stall",      VmStat::COMPACT_STALL },
+    { "compact_success",    VmStat::COMPACT_SUCCESS },
+    { "oom_kill",           VmStat::OOM_KILL },
+    { "pgfault",            VmStat::PGFAULT },
+    { "pgmajfault",         VmStat::PGMAJFAULT },
+    { "pgscan_direct",      VmStat::PGSCAN_DIRECT },
+    { "pgscan_kswapd",      VmStat::PGSCAN_KSWAPD },
+    { "pgsteal_direct",     VmStat::PGSTEAL_DIRECT },
+    { "pgsteal_kswapd",     VmStat::PGSTEAL_KSWAPD },
+    { "pswpin",             VmStat::PSWPIN },
+    { "pswpout",            VmStat::PSWPOUT },
+};
+
+const char * names[VmStat::NCOUNTERS] = {
+    "allocstall/s",
+    "compact_fail/s",
+    "compact_stall/s",
+    "compact_success/s",
+    "oom_kill/s",
+    "pgfault/s",
+    "pgmajfault/s",
+    "pgscan_direct/s",
+    "pgscan_kswapd/s",
+    "pgsteal_direct/s",
+    "pgsteal_kswapd/s",
+    "pswpin/s",
+    "pswpout/s",
+};
+
+/*
+ * Find the table entry for the len byte name.
+ *
+ * @return  - Entry or NULL if the counter is not of interest.
+ */
+const vmstat_key * find_key(const char *name, size_t len)
+{
+    int lo = 0;
+    int hi = sizeof(keys) / sizeof(keys[0]) - 1;
+
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int c = strncmp(keys[mid].name, name, len);
+
+        if (!c && keys[mid].name[len])
+            c = 1;
+
+        if (!c)
+            return &keys[mid];
+        else if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+
+    return NULL;
+}
+
+} // namespace
+
+VmStat::VmStat(FileSet &files) :
+    m_last(0),
+    m_pgmajfault_warn(1000),
+    m_allocstall_warn(10),
+    m_files(&files),
+    m_source(files.add("/proc/vmstat"))
+{
+    memset(m_values, 0, sizeof(m_values));
+    memset(m_last_values, 0, sizeof(m_last_values));
+    memset(m_rates, 0, sizeof(m_rates));
+
+    ros::param::get("~vmstat/pgmajfault_warn", m_pgmajfault_warn);
+    ros::param::get("~vmstat/allocstall_warn", m_allocstall_warn);
+}
+
+void VmStat::ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+
+    if (update()) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Update failed");
+        return;
+    }
+
+    if (m_rates[ALLOCSTALL] > m_allocstall_warn)
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Direct reclaim stalls");
+    else if (m_rates[PGMAJFAULT] > m_pgmajfault_warn)
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Major page faults");
+    else
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+
+    for (unsigned int i = 0; i < NCOUNTERS; ++i)
+        values.add(names[i], m_rates[i]);
+}
+
+int VmStat::update()
+{
+    const char *data;
+    size_t len;
+    if (m_files->get(m_source, data, len)) {
+        ROS_ERROR("%s:  Failed to read /proc/vmstat", __func__);
+        return EIO;
+    }
+
+    memset(m_values, 0, sizeof(m_values));
+
+    /* pgfault 123456 */
+    const char *end = data + len;
+    for (const char *p = data; p < end; ++p) {
+        const char *eol = line_end(p, end);
+        const char *sep = static_cast<const char *>(memchr(p, ' ', eol - p));
+
+        if (sep) {
+            const vmstat_key *key = find_key(p, sep - p);
+            if (key)
+                m_values[key->counter] += strtoull(sep + 1, NULL, 10);
+        }
+
+        p = eol;
+    }
+
+    double now = monotonic_seconds();
+    double dt = now - m_last;
+
+    for (unsigned int i = 0; i < NCOUNTERS; ++i) {
+        if (m_last > 0 && dt > 0 && m_values[i] >= m_last_values[i])
+            m_rates[i] = (m_values[i] - m_last_values[i]) / dt;
+        else
+            m_rates[i] = 0;
+
+        m_last_values[i] = m_values[i];
+    }
+    m_last = now;
+
+    return 0;
+}
+
+} // namespace sysmon
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <diagnostic_updater/diagnostic_updater.h>
+
+#include "fileset.hpp"
+
+namespace sysmon {
+
+class VmStat {
+    /*
+     * Parser for /proc/vmstat.  Only the paging and reclaim counters listed
+     * in a static table are kept, the remaining lines are skipped after a
+     * lookup on their name.  The counters are published via ROS diagnostics as
+     * per second rates.
+     *
+     * ROS Parameters:
+     *
+     * ~/vmstat/pgmajfault_warn:    Major faults per second above which the
+     *                              status is raised to WARN.  Default 1000.
+     *
+     * ~/vmstat/allocstall_warn:    Direct reclaim stalls per second above
+     *                              which the status is raised to WARN.
+     *                              Default 10.
+     */
+    public:
+        enum counter {
+            ALLOCSTALL,
+            COMPACT_FAIL,
+            COMPACT_STALL,
+            COMPACT_SUCCESS,
+            OOM_KILL,
+            PGFAULT,
+            PGMAJFAULT,
+            PGSCAN_DIRECT,
+            PGSCAN_KSWAPD,
+            PGSTEAL_DIRECT,
+            PGSTEAL_KSWAPD,
+            PSWPIN,
+            PSWPOUT,
+            NCOUNTERS
+        };
+
+        /*
+         * Constructor
+         *
+         * @param files - Set /proc/vmstat is registered with and read from.
+         */
+        VmStat(FileSet &files);
+
+        /*
+         * Update the ROS diagnostics.
+         */
+        void ros_update(diagnostic_updater::DiagnosticStatusWrapper &dsw);
+
+    private:
+        /*
+         * Read the latest values from /proc/vmstat.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int update();
+
+        unsigned long long  m_values[NCOUNTERS];
+        unsigned long long  m_last_values[NCOUNTERS];
+        double              m_rates[NCOUNTERS];
+        double              m_last;
+
+        double              m_pgmajfault_warn;
+        double              m_allocstall_warn;
+
+        FileSet *           m_files;
+        int                 m_source;
+};
+
+} // namespace sysmon
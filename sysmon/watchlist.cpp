@@ -0,0 +1,474 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+#include <set>
+#include <sstream>
+
+#include "clock.hpp"
+#include "procstat.hpp"
+#include "rosadapter.hpp"
+#include "status.hpp"
+#include "watchlist.hpp"
+
+namespace sysmon {
+
+namespace {
+
+/* Longest wait between /proc scans for an entry that matches nothing */
+const double max_retry_interval = 60;
+
+int open_proc(int pid, const char *file)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/%s", pid, file);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+int pidfd_open(int pid)
+{
+#ifdef __NR_pidfd_open
+    return syscall(__NR_pidfd_open, pid, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/*
+ * pread() the whole of a small proc file into buf, NUL terminated.
+ *
+ * @return  - bytes read or -errno.
+ */
+ssize_t read_held(int fd, char *buf, size_t size)
+{
+    ssize_t n = pread(fd, buf, size - 1, 0);
+    if (n < 0)
+        return -errno;
+
+    buf[n] = '\0';
+    return n;
+}
+
+/*
+ * Pick the resident set size and context switch counts out of a
+ * /proc/[pid]/status file, they are left alone if missing.
+ */
+void parse_status(const char *buf, long &rss, unsigned long long &vcsw, unsigned long long &nvcsw)
+{
+    for (const char *line = buf; line && *line; ) {
+        const char *next = strchr(line, '\n');
+
+        if (!strncmp(line, "VmRSS:", 6))
+            rss = strtol(line + 6, NULL, 10);
+        else if (!strncmp(line, "voluntary_ctxt_switches:", 24))
+            vcsw = strtoull(line + 24, NULL, 10);
+        else if (!strncmp(line, "nonvoluntary_ctxt_switches:", 27))
+            nvcsw = strtoull(line + 27, NULL, 10);
+
+        line = next ? next + 1 : NULL;
+    }
+}
+
+/*
+ * Whether a process matches a watchlist entry, either by exact command name
+ * or by a wildcard match against its command line.
+ */
+bool matches(const std::string &pattern, int pid)
+{
+    pid_stat st;
+    if (read_pid_stat(pid, st))
+        return false;
+
+    if (st.comm == pattern)
+        return true;
+
+    int fd = open_proc(pid, "cmdline");
+    if (fd < 0)
+        return false;
+
+    char buf[4096];
+    ssize_t n = read_held(fd, buf, sizeof(buf));
+    close(fd);
+
+    /* Kernel threads have an empty command line */
+    if (n <= 0)
+        return false;
+
+    /* Arguments are NUL separated */
+    while (n > 0 && buf[n - 1] == '\0')
+        --n;
+    for (ssize_t i = 0; i < n; ++i) {
+        if (buf[i] == '\0')
+            buf[i] = ' ';
+    }
+    buf[n] = '\0';
+
+    return fnmatch(pattern.c_str(), buf, 0) == 0;
+}
+
+} // namespace
+
+Watchlist::Watchlist()
+{
+    fill_watchlist();
+}
+
+Watchlist::~Watchlist()
+{
+    for (std::vector<target>::iterator it = m_targets.begin(); it != m_targets.end(); ++it)
+        release(*it);
+}
+
+std::vector<std::string> Watchlist::entries() const
+{
+    std::vector<std::string> ret;
+    for (std::vector<target>::const_iterator it = m_targets.begin(); it != m_targets.end(); ++it)
+        ret.push_back((*it).pattern);
+    return ret;
+}
+
+void Watchlist::ros_update(unsigned int entry, diagnostic_updater::DiagnosticStatusWrapper &dsw)
+{
+    StatusValues values(dsw);
+
+    if (entry >= m_targets.size()) {
+        dsw.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "Unknown watchlist entry");
+        return;
+    }
+
+    target &t = m_targets[entry];
+
+    if (t.pid > 0 && exited(t))
+        release(t);
+
+    /* A process that exits between checks fails the update, try once more */
+    for (unsigned int attempt = 0; ; ++attempt) {
+        if (t.pid <= 0 && resolve(t)) {
+            dsw.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Not running");
+            return;
+        }
+
+        if (!update(t))
+            break;
+
+        release(t);
+        if (attempt) {
+            dsw.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Not running");
+            return;
+        }
+    }
+
+    dsw.summary(diagnostic_msgs::DiagnosticStatus::OK, "OK");
+
+    values.add("pid", t.pid);
+    values.add("comm", t.comm);
+    values.add("state", t.state);
+    values.add("cpu %", t.cpu);
+    values.add("rss kB", t.rss);
+    values.add("threads", t.threads.size());
+    values.add("voluntary context switches/s", t.vcsw_rate);
+    values.add("involuntary context switches/s", t.nvcsw_rate);
+    values.add("minor faults/s", t.minflt_rate);
+    values.add("major faults/s", t.majflt_rate);
+
+    for (std::vector<thread>::const_iterator it = t.threads.begin(); it != t.threads.end(); ++it) {
+        values.add((*it).cpu_key, (*it).cpu);
+        values.add((*it).vcsw_key, (*it).vcsw_rate);
+        values.add((*it).nvcsw_key, (*it).nvcsw_rate);
+        values.add((*it).minflt_key, (*it).minflt_rate);
+        values.add((*it).majflt_key, (*it).majflt_rate);
+    }
+}
+
+void Watchlist::fill_watchlist()
+{
+    std::set<std::string> watchlist = param_list("~process/watchlist");
+
+    for (std::set<std::string>::const_iterator it = watchlist.begin(); it != watchlist.end(); ++it) {
+        target t;
+        t.pattern = *it;
+        t.pid = t.pidfd = t.stat_fd = t.status_fd = -1;
+        t.retry_at = t.retry_interval = 0;
+        m_targets.push_back(t);
+    }
+}
+
+int Watchlist::resolve(target &t)
+{
+    double now = monotonic_seconds();
+    if (now < t.retry_at)
+        return ESRCH;
+
+    DIR *dir = opendir("/proc");
+    if (!dir)
+        return errno;
+
+    int pid = -1;
+    struct dirent *ent;
+    while ((ent = readdir(dir))) {
+        if (!isdigit(ent->d_name[0]))
+            continue;
+
+        if (matches(t.pattern, atoi(ent->d_name))) {
+            pid = atoi(ent->d_name);
+            break;
+        }
+    }
+    closedir(dir);
+
+    /* Back off so an entry that is not running does not scan /proc every cycle */
+    if (pid < 0) {
+        t.retry_interval = t.retry_interval > 0 ? std::min(2 * t.retry_interval, max_retry_interval) : 1;
+        t.retry_at = now + t.retry_interval;
+        return ESRCH;
+    }
+
+    /* Taken first so the descriptors below can be checked against it */
+    t.pid = pid;
+    t.pidfd = pidfd_open(pid);
+    t.stat_fd = open_proc(pid, "stat");
+    t.status_fd = open_proc(pid, "status");
+
+    if (t.stat_fd < 0 || t.status_fd < 0 || exited(t)) {
+        release(t);
+        return ESRCH;
+    }
+
+    t.retry_at = t.retry_interval = 0;
+    t.last = 0;
+    t.cpu = t.minflt_rate = t.majflt_rate = t.vcsw_rate = t.nvcsw_rate = 0;
+
+    ROS_INFO("%s:  Watching pid %d for '%s'", __func__, pid, t.pattern.c_str());
+    return 0;
+}
+
+void Watchlist::release(target &t)
+{
+    for (std::vector<thread>::iterator it = t.threads.begin(); it != t.threads.end(); ++it) {
+        close((*it).stat_fd);
+        close((*it).status_fd);
+    }
+    t.threads.clear();
+
+    if (t.pidfd >= 0)
+        close(t.pidfd);
+    if (t.stat_fd >= 0)
+        close(t.stat_fd);
+    if (t.status_fd >= 0)
+        close(t.status_fd);
+
+    t.pid = t.pidfd = t.stat_fd = t.status_fd = -1;
+}
+
+bool Watchlist::exited(const target &t) const
+{
+    /* Without pidfd support exits surface as ESRCH from the held descriptors */
+    if (t.pidfd < 0)
+        return false;
+
+    struct pollfd pfd;
+    pfd.fd = t.pidfd;
+    pfd.events = POLLIN;
+
+    return poll(&pfd, 1, 0) > 0;
+}
+
+int Watchlist::update(target &t)
+{
+    static const double hz = sysconf(_SC_CLK_TCK);
+    static const long page_kb = sysconf(_SC_PAGESIZE) / 1024;
+    char buf[4096];
+
+    ssize_t n = read_held(t.stat_fd, buf, sizeof(buf));
+    if (n < 0)
+        return -n;
+
+    pid_stat st;
+    if (parse_pid_stat(buf, n, st))
+        return EINVAL;
+
+    n = read_held(t.status_fd, buf, sizeof(buf));
+    if (n < 0)
+        return -n;
+
+    /* Kernel threads have no VmRSS line */
+    long rss = st.rss * page_kb;
+    unsigned long long vcsw = 0;
+    unsigned long long nvcsw = 0;
+    parse_status(buf, rss, vcsw, nvcsw);
+
+    double now = monotonic_seconds();
+    double dt = t.last > 0 ? now - t.last : 0;
+    unsigned long long ticks = st.utime + st.stime;
+
+    if (dt > 0) {
+        t.cpu = ticks >= t.ticks ? 100.0 * (ticks - t.ticks) / hz / dt : 0;
+        t.minflt_rate = st.minflt >= t.minflt ? (st.minflt - t.minflt) / dt : 0;
+        t.majflt_rate = st.majflt >= t.majflt ? (st.majflt - t.majflt) / dt : 0;
+        t.vcsw_rate = vcsw >= t.vcsw ? (vcsw - t.vcsw) / dt : 0;
+        t.nvcsw_rate = nvcsw >= t.nvcsw ? (nvcsw - t.nvcsw) / dt : 0;
+    }
+
+    t.comm = st.comm;
+    t.state = st.state;
+    t.rss = rss;
+    t.ticks = ticks;
+    t.minflt = st.minflt;
+    t.majflt = st.majflt;
+    t.vcsw = vcsw;
+    t.nvcsw = nvcsw;
+    t.last = now;
+
+    update_threads(t, st.num_threads, dt);
+
+    return 0;
+}
+
+void Watchlist::update_threads(target &t, long num_threads, double dt)
+{
+    static const double hz = sysconf(_SC_CLK_TCK);
+
+    if (num_threads != (long)t.threads.size()) {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/task", t.pid);
+
+        DIR *dir = opendir(path);
+        if (dir) {
+            std::vector<thread> threads;
+            struct dirent *ent;
+
+            while ((ent = readdir(dir))) {
+                if (!isdigit(ent->d_name[0]))
+                    continue;
+
+                int tid = atoi(ent->d_name);
+                std::vector<thread>::iterator it;
+                for (it = t.threads.begin(); it != t.threads.end(); ++it) {
+                    if ((*it).tid == tid)
+                        break;
+                }
+
+                if (it != t.threads.end()) {
+                    threads.push_back(*it);
+                    t.threads.erase(it);
+                    continue;
+                }
+
+                std::string task = std::string("task/") + ent->d_name;
+                thread th;
+                th.tid = tid;
+                th.stat_fd = open_proc(t.pid, (task + "/stat").c_str());
+                th.status_fd = open_proc(t.pid, (task + "/status").c_str());
+                th.ticks = th.minflt = th.majflt = th.vcsw = th.nvcsw = 0;
+                th.cpu = th.minflt_rate = th.majflt_rate = th.vcsw_rate = th.nvcsw_rate = 0;
+
+                if (th.stat_fd >= 0 && th.status_fd >= 0) {
+                    threads.push_back(th);
+                    continue;
+                }
+                if (th.stat_fd >= 0)
+                    close(th.stat_fd);
+                if (th.status_fd >= 0)
+                    close(th.status_fd);
+            }
+            closedir(dir);
+
+            /* Whatever is left has exited */
+            for (std::vector<thread>::iterator it = t.threads.begin(); it != t.threads.end(); ++it) {
+                close((*it).stat_fd);
+                close((*it).status_fd);
+            }
+            t.threads.swap(threads);
+        }
+    }
+
+    char buf[4096];
+    for (std::vector<thread>::iterator it = t.threads.begin(); it != t.threads.end(); ) {
+        pid_stat st;
+        ssize_t n = read_held((*it).stat_fd, buf, sizeof(buf));
+        bool ok = n >= 0 && !parse_pid_stat(buf, n, st);
+
+        long rss = 0;
+        unsigned long long vcsw = 0;
+        unsigned long long nvcsw = 0;
+        if (ok && (ok = read_held((*it).status_fd, buf, sizeof(buf)) >= 0))
+            parse_status(buf, rss, vcsw, nvcsw);
+
+        if (!ok) {
+            close((*it).stat_fd);
+            close((*it).status_fd);
+            it = t.threads.erase(it);
+            continue;
+        }
+
+        /* Rates of new threads start from the next cycle */
+        unsigned long long ticks = st.utime + st.stime;
+        if (dt > 0 && (*it).comm.size()) {
+            (*it).cpu = ticks >= (*it).ticks ? 100.0 * (ticks - (*it).ticks) / hz / dt : 0;
+            (*it).minflt_rate = st.minflt >= (*it).minflt ? (st.minflt - (*it).minflt) / dt : 0;
+            (*it).majflt_rate = st.majflt >= (*it).majflt ? (st.majflt - (*it).majflt) / dt : 0;
+            (*it).vcsw_rate = vcsw >= (*it).vcsw ? (vcsw - (*it).vcsw) / dt : 0;
+            (*it).nvcsw_rate = nvcsw >= (*it).nvcsw ? (nvcsw - (*it).nvcsw) / dt : 0;
+        }
+
+        if ((*it).comm != st.comm) {
+            std::ostringstream s;
+            s << "thread " << (*it).tid << " (" << st.comm << ") ";
+
+            (*it).comm = st.comm;
+            (*it).cpu_key = s.str() + "cpu %";
+            (*it).vcsw_key = s.str() + "voluntary context switches/s";
+            (*it).nvcsw_key = s.str() + "involuntary context switches/s";
+            (*it).minflt_key = s.str() + "minor faults/s";
+            (*it).majflt_key = s.str() + "major faults/s";
+        }
+
+        (*it).ticks = ticks;
+        (*it).minflt = st.minflt;
+        (*it).majflt = st.majflt;
+        (*it).vcsw = vcsw;
+        (*it).nvcsw = nvcsw;
+        ++it;
+    }
+}
+
+} // namespace sysmon
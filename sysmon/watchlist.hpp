@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <diagnostic_updater/diagnostic_updater.h>
+
+namespace sysmon {
+
+class Watchlist {
+    /*
+     * Monitors a fixed list of processes and publishes their resource usage
+     * and that of each of their threads via ROS diagnostics.
+     *
+     * Each entry is resolved to a process once, matching either the command
+     * name exactly or the command line against a shell wildcard pattern.  The
+     * first match is monitored.  A pidfd and descriptors for
+     * /proc/[pid]/stat, status and task/[tid]/stat and status are then held
+     * open and re-read with pread() every cycle.  Once the pidfd reports the process
+     * has exited the descriptors are released and the entry is resolved
+     * again.  While an entry matches nothing, /proc is scanned for it after
+     * 1, 2, 4 and so on seconds, up to once a minute.
+     *
+     * ROS Parameters:
+     *
+     * ~/process/watchlist: List of process names or command line patterns
+     *                      (see fnmatch(3)) to monitor.  This is a list of
+     *                      XmlRpcValue::TypeString.
+     */
+    public:
+        /*
+         * Constructor
+         */
+        Watchlist();
+
+        ~Watchlist();
+
+        /*
+         * Return the list of entries being monitored.
+         */
+        std::vector<std::string> entries() const;
+
+        /*
+         * Update the ROS diagnostics.
+         *
+         * @param entry - Index into entries() to publish.
+         */
+        void ros_update(unsigned int entry, diagnostic_updater::DiagnosticStatusWrapper &dsw);
+
+    private:
+        struct thread {
+            int                 tid;
+            int                 stat_fd;
+            int                 status_fd;
+            std::string         comm;
+            unsigned long long  ticks;
+            unsigned long long  minflt;
+            unsigned long long  majflt;
+            unsigned long long  vcsw;
+            unsigned long long  nvcsw;
+            double              cpu;
+            double              minflt_rate;
+            double              majflt_rate;
+            double              vcsw_rate;
+            double              nvcsw_rate;
+
+            /* Built when the thread is first seen or renamed */
+            std::string         cpu_key;
+            std::string         minflt_key;
+            std::string         majflt_key;
+            std::string         vcsw_key;
+            std::string         nvcsw_key;
+        };
+
+        struct target {
+            std::string         pattern;
+
+            int                 pid;
+            int                 pidfd;
+            int                 stat_fd;
+            int                 status_fd;
+            std::vector<thread> threads;
+
+            std::string         comm;
+            char                state;
+            long                rss;
+            unsigned long long  ticks;
+            unsigned long long  minflt;
+            unsigned long long  majflt;
+            unsigned long long  vcsw;
+            unsigned long long  nvcsw;
+            double              last;
+
+            double              cpu;
+            double              minflt_rate;
+            double              majflt_rate;
+            double              vcsw_rate;
+            double              nvcsw_rate;
+
+            /* When to scan /proc next while nothing matches */
+            double              retry_at;
+            double              retry_interval;
+        };
+
+        /*
+         * Query the parameter server for the processes to monitor.
+         */
+        void fill_watchlist();
+
+        /*
+         * Find the first process matching the entry's pattern and open its
+         * descriptors.  Does nothing until t.retry_at after a scan finds no
+         * match.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int resolve(target &t);
+
+        /*
+         * Close every descriptor held for a process.
+         */
+        void release(target &t);
+
+        /*
+         * Whether the process held by t has exited.
+         */
+        bool exited(const target &t) const;
+
+        /*
+         * Re-read the held descriptors and compute rates.
+         *
+         * @return  - 0 on success, appropriate errno otherwise.
+         */
+        int update(target &t);
+
+        /*
+         * Re-read the thread stat and status files, re-listing task/ when the
+         * thread count changes.
+         */
+        void update_threads(target &t, long num_threads, double dt);
+
+        Watchlist(const Watchlist &);
+        Watchlist & operator=(const Watchlist &);
+
+        std::vector<target> m_targets;
+};
+
+} // namespace sysmon
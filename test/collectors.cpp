@@ -0,0 +1,383 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * test_collectors - check what the libsysmon collectors parse out of the
+ * /proc and /etc/mtab fixtures under the directory given as the only
+ * argument, read through FileSet's root.
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ftw.h>
+#include <sys/stat.h>
+
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "cpuinfo.hpp"
+#include "cputime.hpp"
+#include "diskusage.hpp"
+#include "fileset.hpp"
+#include "interrupts.hpp"
+#include "loadavg.hpp"
+#include "meminfo.hpp"
+#include "netstat.hpp"
+#include "sink.hpp"
+
+namespace {
+
+unsigned int failures;
+
+#define CHECK(cond) check((cond), __FILE__, __LINE__, #cond)
+
+void check(bool ok, const char *file, int line, const char *what)
+{
+    if (ok)
+        return;
+
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+    ++failures;
+}
+
+class Samples : public sysmon::Sink {
+    /*
+     * Keeps the last value added for every task and key.
+     */
+    public:
+        using Sink::add;
+        void add(const std::string &task, const std::string &key, double value)
+        {
+            m_values[task][key] = value;
+        }
+
+        int commit()
+        {
+            return 0;
+        }
+
+        bool has(const std::string &task, const std::string &key) const
+        {
+            std::map<std::string, std::map<std::string, double> >::const_iterator t = m_values.find(task);
+            return t != m_values.end() && (*t).second.find(key) != (*t).second.end();
+        }
+
+        double get(const std::string &task, const std::string &key) const
+        {
+            std::map<std::string, std::map<std::string, double> >::const_iterator t = m_values.find(task);
+            if (t == m_values.end())
+                return NAN;
+
+            std::map<std::string, double>::const_iterator k = (*t).second.find(key);
+            return k == (*t).second.end() ? NAN : (*k).second;
+        }
+
+        size_t tasks() const
+        {
+            return m_values.size();
+        }
+
+    private:
+        std::map<std::string, std::map<std::string, double> > m_values;
+};
+
+void test_cputime(const std::string &root)
+{
+    sysmon::FileSet files(false, root);
+    sysmon::CpuTime cputime(files);
+    Samples samples;
+
+    CHECK(!files.read());
+    CHECK(!cputime.update());
+    cputime.record(samples);
+
+    CHECK(cputime.nproc() == 2);
+    CHECK(samples.tasks() == 3);
+
+    CHECK(samples.get("CPU Time - Total", "user") == 100);
+    CHECK(samples.get("CPU Time - Total", "idle") == 1000);
+    CHECK(samples.get("CPU Time - Total", "softirq") == 3);
+    CHECK(samples.get("CPU Time - Total", "guest_nice") == 0);
+    CHECK(samples.get("CPU Time - Total", "total") == 1140);
+    CHECK(samples.get("CPU Time - Total", "procs_running") == 3);
+    CHECK(samples.get("CPU Time - Total", "procs_blocked") == 1);
+    CHECK(samples.get("CPU Time - Total", "run queue per cpu") == 1.5);
+
+    /* Rates need a second cycle */
+    CHECK(samples.get("CPU Time - Total", "context switches/s") == 0);
+    CHECK(samples.get("CPU Time - Total", "forks/s") == 0);
+
+    CHECK(samples.get("Cpu Time - Processor 0", "user") == 60);
+    CHECK(samples.get("Cpu Time - Processor 0", "total") == 586);
+    CHECK(samples.get("Cpu Time - Processor 1", "system") == 10);
+    CHECK(samples.get("Cpu Time - Processor 1", "total") == 554);
+}
+
+void test_meminfo(const std::string &root)
+{
+    sysmon::FileSet files(false, root);
+    sysmon::MemInfo meminfo(files);
+    Samples samples;
+
+    CHECK(!files.read());
+    CHECK(!meminfo.update());
+    meminfo.record(samples);
+
+    CHECK(samples.get("Memory", "MemTotal") == 8069876);
+    CHECK(samples.get("Memory", "MemAvailable") == 4034938);
+    CHECK(samples.get("Memory", "HugePages_Total") == 0);
+    CHECK(samples.get("Memory", "Hugepagesize") == 2048);
+
+    std::set<std::string> whitelist;
+    whitelist.insert("MemFree");
+
+    sysmon::MemInfo filtered(files, whitelist);
+    Samples only;
+
+    CHECK(!filtered.update());
+    filtered.record(only);
+
+    CHECK(only.get("Memory", "MemFree") == 1234567);
+    CHECK(!only.has("Memory", "MemTotal"));
+}
+
+void test_loadavg(const std::string &root)
+{
+    sysmon::FileSet files(false, root);
+    sysmon::LoadAvg loadavg(files);
+    Samples samples;
+
+    CHECK(!files.read());
+    CHECK(!loadavg.update());
+    loadavg.record(samples);
+
+    CHECK(samples.get("Load Average", "1 minute") == 0.20);
+    CHECK(samples.get("Load Average", "5 minute") == 0.18);
+    CHECK(samples.get("Load Average", "15 minute") == 0.12);
+}
+
+void test_cpuinfo(const std::string &root)
+{
+    sysmon::FileSet files(false, root);
+    sysmon::CpuInfo cpuinfo(files);
+
+    CHECK(!files.read());
+    CHECK(cpuinfo.nproc() == 2);
+
+    const sysmon::CpuInfo::cpuinfo &cpu0 = cpuinfo.values(0);
+    const sysmon::CpuInfo::cpuinfo &cpu1 = cpuinfo.values(1);
+
+    CHECK(cpu0.find("model name") != cpu0.end());
+    CHECK((*cpu0.find("model name")).second == "Intel(R) Core(TM) i7-2600 CPU @ 3.40GHz");
+    CHECK((*cpu0.find("cpu MHz")).second == "3401.000");
+    CHECK((*cpu1.find("cpu MHz")).second == "1600.000");
+    CHECK((*cpu1.find("flags")).second == "fpu vme de pse");
+    CHECK(cpu1.find("power management") != cpu1.end());
+    CHECK((*cpu1.find("power management")).second == "");
+}
+
+void test_diskusage(const std::string &root)
+{
+    sysmon::FileSet files(false, root);
+    sysmon::DiskUsage diskusage(files);
+    Samples samples;
+
+    CHECK(!files.read());
+
+    /* Pseudo filesystems are skipped and \040 is unescaped */
+    std::vector<std::string> disks = diskusage.disks();
+    CHECK(disks.size() == 2);
+    CHECK(disks.size() == 2 && disks[0] == "/");
+    CHECK(disks.size() == 2 && disks[1] == "/mnt/my data");
+
+    diskusage.record(samples);
+    CHECK(samples.get("Disk Usage - /", "size") > 0);
+    CHECK(samples.get("Disk Usage - /", "usage") >= 0);
+    CHECK(samples.get("Disk Usage - /", "usage") <= 100);
+    CHECK(samples.has("Disk Usage - /mnt/my data", "avail"));
+    CHECK(samples.get("Disk Usage - /mnt/my data", "fill rate (B/s)") == 0);
+
+    std::set<std::string> mountlist;
+    mountlist.insert("/mnt/my data");
+
+    sysmon::DiskUsage listed(files, mountlist);
+    disks = listed.disks();
+    CHECK(disks.size() == 1 && disks[0] == "/mnt/my data");
+}
+
+/*
+ * Copy a fixture over path, in place so FileSet's descriptor stays valid.
+ */
+bool copy_file(const std::string &from, const std::string &to)
+{
+    std::ifstream in(from.c_str());
+    std::ofstream out(to.c_str(), std::ios::out | std::ios::trunc);
+    out << in.rdbuf();
+    return in && out;
+}
+
+int remove_entry(const char *path, const struct stat *, int, struct FTW *)
+{
+    return remove(path);
+}
+
+void test_netstat(const std::string &fixtures)
+{
+    char root[] = "/tmp/test_collectors.XXXXXX";
+    CHECK(mkdtemp(root) != NULL);
+
+    std::string net = std::string(root) + "/proc/net";
+    std::string from = fixtures + "/proc/net";
+    CHECK(!mkdir((std::string(root) + "/proc").c_str(), 0755));
+    CHECK(!mkdir(net.c_str(), 0755));
+
+    /* No ICMP has been seen yet, IcmpMsg is missing */
+    CHECK(copy_file(from + "/snmp-no-icmpmsg", net + "/snmp"));
+    CHECK(copy_file(from + "/netstat", net + "/netstat"));
+    CHECK(copy_file(from + "/sockstat", net + "/sockstat"));
+
+    {
+        sysmon::FileSet files(false, root);
+        sysmon::NetStat netstat(files);
+        Samples samples;
+
+        CHECK(!files.read());
+        CHECK(!netstat.update());
+        netstat.record(samples);
+
+        CHECK(samples.get("Network Protocols", "Tcp sockets") == 42);
+        CHECK(samples.get("Network Protocols", "Tcp time wait sockets") == 7);
+        CHECK(samples.get("Network Protocols", "Udp memory (pages)") == 2);
+        CHECK(samples.get("Network Protocols", "Tcp OutSegs/s") == 0);
+
+        /* The IcmpMsg pair appears before Tcp and moves the lines after it */
+        CHECK(copy_file(from + "/snmp", net + "/snmp"));
+
+        CHECK(!files.read());
+        CHECK(!netstat.update());
+        netstat.record(samples);
+
+        /* 2000 segments sent, 50 retransmitted and 1000 datagrams received */
+        double segs = samples.get("Network Protocols", "Tcp OutSegs/s");
+        CHECK(segs > 0);
+        CHECK(fabs(samples.get("Network Protocols", "Tcp RetransSegs/s") / segs - 0.025) < 1e-9);
+        CHECK(fabs(samples.get("Network Protocols", "Udp InDatagrams/s") / segs - 0.5) < 1e-9);
+        CHECK(fabs(samples.get("Network Protocols", "Tcp retransmits (%)") - 2.5) < 1e-9);
+        CHECK(samples.get("Network Protocols", "Tcp AttemptFails/s") == 0);
+        CHECK(samples.get("Network Protocols", "TcpExt ListenOverflows/s") == 0);
+    }
+
+    nftw(root, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+void test_interrupts(const std::string &fixtures)
+{
+    char root[] = "/tmp/test_collectors.XXXXXX";
+    CHECK(mkdtemp(root) != NULL);
+
+    std::string proc = std::string(root) + "/proc";
+    CHECK(!mkdir(proc.c_str(), 0755));
+    CHECK(copy_file(fixtures + "/proc/interrupts", proc + "/interrupts"));
+
+    {
+        sysmon::FileSet files(false, root);
+        sysmon::Interrupts interrupts(files, "/proc/interrupts", "Interrupts");
+        Samples samples;
+
+        CHECK(!files.read());
+        CHECK(interrupts.nproc() == 12);
+        CHECK(interrupts.cpu(11) == 11);
+
+        /* Each count goes up by 10 * (row + 1) * (column + 1) */
+        CHECK(copy_file(fixtures + "/proc/interrupts-next", proc + "/interrupts"));
+        CHECK(!files.read());
+        CHECK(!interrupts.update());
+        interrupts.record(samples);
+
+        double cpu0 = samples.get("Interrupts - Total", "CPU0");
+        CHECK(cpu0 > 0);
+        CHECK(fabs(samples.get("Interrupts - Total", "CPU11") / cpu0 - 12) < 1e-9);
+
+        /* Counts wider than a machine word and next to the 32 bit limit */
+        const char *loc = "LOC (Local timer interrupts)";
+        double loc0 = samples.get("Interrupts - Processor 0", loc);
+        CHECK(loc0 > 0);
+        CHECK(fabs(samples.get("Interrupts - Processor 7", loc) / loc0 - 8) < 1e-9);
+        CHECK(fabs(samples.get("Interrupts - Processor 3", "RES (Rescheduling interrupts)") / loc0 - 4.5) < 1e-9);
+        CHECK(fabs(samples.get("Interrupts - Total", loc) / loc0 - 78) < 1e-9);
+        CHECK(samples.has("Interrupts - Total", "122 (IR-PCI-MSI 1048576-edge      enp3s0-rx-0)"));
+        CHECK(samples.get("Interrupts - Total", "ERR") == 0);
+
+        /* CPU5 goes offline, counts must not be taken against other columns */
+        CHECK(copy_file(fixtures + "/proc/interrupts-hotplug", proc + "/interrupts"));
+        CHECK(!files.read());
+        CHECK(!interrupts.update());
+        CHECK(interrupts.nproc() == 11);
+        CHECK(interrupts.cpu(5) == 6);
+
+        Samples hotplugged;
+        interrupts.record(hotplugged);
+        CHECK(hotplugged.get("Interrupts - Total", "CPU6") == 0);
+        CHECK(hotplugged.get("Interrupts - Total", "CPU11") == 0);
+        CHECK(hotplugged.get("Interrupts - Total", loc) == 0);
+        CHECK(!hotplugged.has("Interrupts - Total", "CPU5"));
+    }
+
+    nftw(root, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s fixtures\n", argv[0]);
+        return 2;
+    }
+
+    test_cputime(argv[1]);
+    test_meminfo(argv[1]);
+    test_loadavg(argv[1]);
+    test_cpuinfo(argv[1]);
+    test_diskusage(argv[1]);
+    test_netstat(argv[1]);
+    test_interrupts(argv[1]);
+
+    if (failures) {
+        fprintf(stderr, "%u checks failed\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2012, Justin Bronder
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the organization nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * test_format - check that format_value() prints doubles as %g does.
+ */
+
+#include <cmath>
+#include <cstdio>
+
+#include <string>
+
+#include "format.hpp"
+
+namespace {
+
+unsigned int failures;
+
+void check(double value)
+{
+    char expected[64];
+    std::string s;
+
+    snprintf(expected, sizeof(expected), "%g", value);
+    sysmon::format_value(s, value);
+
+    /* Whole counts are printed in full */
+    if (value > -1e15 && value < 1e15 && value == (long long)value)
+        return;
+
+    if (s != expected) {
+        fprintf(stderr, "%.17g:  \"%s\", %%g gives \"%s\"\n", value, s.c_str(), expected);
+        ++failures;
+    }
+}
+
+} // namespace
+
+int main()
+{
+    /* Round half to even on the exact value, carries and both notations */
+    static const double values[] = {
+        21112.349999999999, 26225.25, 26225.35, 0.125, 2.5e-4, 99999.95,
+        999999.5, 9.9999995, 1234567.5, 123456789.25, 0.000123456789,
+        -3.14159265, -1e14 - 0.5,
+    };
+    for (unsigned int i = 0; i < sizeof(values) / sizeof(values[0]); ++i)
+        check(values[i]);
+
+    /* Values across the range printed without printf, some on ties */
+    unsigned long long seed = 1;
+    for (unsigned int i = 0; i < 200000; ++i) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        double v = pow(10, (seed >> 11) * (1.0 / 9007199254740992.0) * 20 - 5);
+
+        check(v);
+        check(-v);
+        check(floor(v * 4) / 4);
+        check(floor(v * 100) / 100 + 0.005);
+    }
+
+    if (failures) {
+        fprintf(stderr, "%u values differ from %%g\n", failures);
+        return 1;
+    }
+
+    return 0;
+}